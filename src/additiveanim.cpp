@@ -0,0 +1,207 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "additiveanim.h"
+#include "reduceanim.h"
+
+static const float identity[3][4] = {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, 1, 1, 0}};
+
+static inline int channelWidth(u32 channel) {
+    return channel == CHANNEL_ROTATION ? 4 : 3;
+}
+
+static void collectNodes(const std::vector<Node> &nodes, std::unordered_map<std::string, const Node *> &byID) {
+    for (const Node &node : nodes) {
+        byID[node.id] = &node;
+        collectNodes(node.children, byID);
+    }
+}
+
+// Whether s / bind is defined for every key. A zero bind component only works if the animated one is zero too.
+static bool canScale(const float *bind, const float *values, size_t nKeys, size_t stride) {
+    for (int c = 0; c < 3; c++) {
+        if (bind[c] != 0) continue;
+        for (size_t k = 0; k < nKeys; k++) {
+            if (values[k * stride + c] != 0) return false;
+        }
+    }
+    return true;
+}
+
+// Replaces nKeys values of channel, stride floats apart, with their difference from bind.
+static void makeRelative(u32 channel, const Node *bind, float *values, size_t nKeys, size_t stride) {
+    if (channel == CHANNEL_TRANSLATION) {
+        for (size_t k = 0; k < nKeys; k++) {
+            float *t = &values[k * stride];
+            for (int c = 0; c < 3; c++) t[c] -= bind->translation[c];
+        }
+    } else if (channel == CHANNEL_SCALE) {
+        for (size_t k = 0; k < nKeys; k++) {
+            float *s = &values[k * stride];
+            for (int c = 0; c < 3; c++) s[c] = bind->scale[c] != 0 ? s[c] / bind->scale[c] : 1;
+        }
+    } else {
+        // conjugate(bind) * r, x y z w order
+        double bx = -bind->rotation[0], by = -bind->rotation[1], bz = -bind->rotation[2], bw = bind->rotation[3];
+        for (size_t k = 0; k < nKeys; k++) {
+            float *r = &values[k * stride];
+            double x = r[0], y = r[1], z = r[2], w = r[3];
+            r[0] = float(bw * x + bx * w + by * z - bz * y);
+            r[1] = float(bw * y - bx * z + by * w + bz * x);
+            r[2] = float(bw * z + bx * y - by * x + bz * w);
+            r[3] = float(bw * w - bx * x - by * y - bz * z);
+        }
+    }
+}
+
+static bool isIdentity(u32 channel, const float *values, size_t nKeys, size_t stride, float maxError) {
+    for (size_t k = 0; k < nKeys; k++) {
+        if (trackKeyError(channel, identity[channel], &values[k * stride]) > maxError) return false;
+    }
+    return true;
+}
+
+// Rebuilds the packed frames without the channels in dropped (indexed like nodeFormats) and the nodes left empty.
+static void dropSampledChannels(Animation *anim, const std::vector<bool> &dropped) {
+    std::vector<std::string> nodeIDs;
+    std::vector<s32> nodeFormats;
+    std::vector<s32> sourceOffsets; // offset of each kept channel in the old frames, in the new order
+    std::vector<s32> widths;
+    s32 stride = 0;
+    for (u32 n = 0; n < anim->nodeIDs.size(); n++) {
+        s32 formats[3] = {-1, -1, -1};
+        bool any = false;
+        for (u32 channel = CHANNEL_TRANSLATION; channel <= CHANNEL_SCALE; channel++) {
+            s32 offset = anim->nodeFormats[3*n + channel];
+            if (offset < 0 || dropped[3*n + channel]) continue;
+            formats[channel] = stride;
+            sourceOffsets.push_back(offset);
+            widths.push_back(channelWidth(channel));
+            stride += channelWidth(channel);
+            any = true;
+        }
+        if (!any) continue;
+        nodeIDs.push_back(anim->nodeIDs[n]);
+        nodeFormats.insert(nodeFormats.end(), formats, formats + 3);
+    }
+
+    std::vector<f32> nodeData(size_t(stride) * anim->frames);
+    for (u32 frame = 0; frame < anim->frames; frame++) {
+        const f32 *src = &anim->nodeData[size_t(frame) * anim->stride];
+        f32 *dst = &nodeData[size_t(frame) * stride];
+        for (size_t c = 0; c < widths.size(); c++) {
+            memcpy(dst, &src[sourceOffsets[c]], widths[c] * sizeof(f32));
+            dst += widths[c];
+        }
+    }
+
+    anim->nodeIDs.swap(nodeIDs);
+    anim->nodeFormats.swap(nodeFormats);
+    anim->nodeData.swap(nodeData);
+    anim->stride = u32(stride);
+}
+
+// Drops the tracks in dropped and renumbers the nodes that have tracks left.
+static void dropTracks(Animation *anim, const std::vector<bool> &dropped) {
+    std::vector<bool> kept(anim->nodeIDs.size(), false);
+    for (size_t t = 0; t < anim->tracks.size(); t++) {
+        if (!dropped[t]) kept[anim->tracks[t].node] = true;
+    }
+    std::vector<u32> remap(anim->nodeIDs.size());
+    std::vector<std::string> nodeIDs;
+    for (u32 n = 0; n < anim->nodeIDs.size(); n++) {
+        remap[n] = u32(nodeIDs.size());
+        if (kept[n]) nodeIDs.push_back(anim->nodeIDs[n]);
+    }
+    std::vector<AnimationTrack> tracks;
+    for (size_t t = 0; t < anim->tracks.size(); t++) {
+        if (dropped[t]) continue;
+        anim->tracks[t].node = remap[anim->tracks[t].node];
+        tracks.push_back(std::move(anim->tracks[t]));
+    }
+    anim->nodeIDs.swap(nodeIDs);
+    anim->tracks.swap(tracks);
+}
+
+void makeAnimationsAdditive(Model *model, Options *opts) {
+    if (!opts->additiveAnimations) return;
+    if (!opts->p3db) {
+        printf("Warning: additive animations are only written with p3db animations (-a), ignoring -A\n");
+        return;
+    }
+
+    std::unordered_map<std::string, const Node *> byID;
+    collectNodes(model->nodes, byID);
+    float maxError[3] = {opts->animError, opts->animError, opts->animError};
+    if (opts->keyError > maxError[CHANNEL_TRANSLATION]) maxError[CHANNEL_TRANSLATION] = maxError[CHANNEL_SCALE] = opts->keyError;
+    if (opts->keyError > 0) maxError[CHANNEL_ROTATION] = float(opts->keyAngleError * M_PI / 180.0);
+
+    for (Animation &anim : model->animations) {
+        std::vector<const Node *> binds(anim.nodeIDs.size());
+        for (size_t n = 0; n < anim.nodeIDs.size(); n++) {
+            auto found = byID.find(anim.nodeIDs[n]);
+            binds[n] = found != byID.end() ? found->second : nullptr;
+        }
+
+        const char *problem = nullptr;
+        for (size_t n = 0; n < binds.size() && !problem; n++) {
+            if (!binds[n]) problem = "animates a node outside the node hierarchy";
+        }
+        if (!problem && anim.tracks.empty()) {
+            for (size_t n = 0; n < binds.size() && !problem; n++) {
+                s32 offset = anim.nodeFormats[3*n + CHANNEL_SCALE];
+                if (offset >= 0 && !canScale(binds[n]->scale, &anim.nodeData[offset], anim.frames, anim.stride)) {
+                    problem = "scales a node from a zero bind scale";
+                }
+            }
+        } else if (!problem) {
+            for (AnimationTrack &track : anim.tracks) {
+                if (track.channel == CHANNEL_SCALE && !canScale(binds[track.node]->scale, track.values.data(), track.times.size(), 3)) {
+                    problem = "scales a node from a zero bind scale";
+                    break;
+                }
+            }
+        }
+        if (problem) {
+            printf("Warning: animation %s %s, it stays absolute\n", anim.id.c_str(), problem);
+            continue;
+        }
+
+        int nChannels = 0, nDropped = 0;
+        if (anim.tracks.empty()) {
+            std::vector<bool> dropped(anim.nodeFormats.size(), false);
+            for (size_t n = 0; n < binds.size(); n++) {
+                for (u32 channel = CHANNEL_TRANSLATION; channel <= CHANNEL_SCALE; channel++) {
+                    s32 offset = anim.nodeFormats[3*n + channel];
+                    if (offset < 0) continue;
+                    nChannels++;
+                    makeRelative(channel, binds[n], &anim.nodeData[offset], anim.frames, anim.stride);
+                    dropped[3*n + channel] = isIdentity(channel, &anim.nodeData[offset], anim.frames, anim.stride, maxError[channel]);
+                    if (dropped[3*n + channel]) nDropped++;
+                }
+            }
+            if (nDropped) dropSampledChannels(&anim, dropped);
+        } else {
+            std::vector<bool> dropped(anim.tracks.size(), false);
+            for (size_t t = 0; t < anim.tracks.size(); t++) {
+                AnimationTrack &track = anim.tracks[t];
+                int width = channelWidth(track.channel);
+                nChannels++;
+                makeRelative(track.channel, binds[track.node], track.values.data(), track.times.size(), width);
+                dropped[t] = isIdentity(track.channel, track.values.data(), track.times.size(), width, maxError[track.channel]);
+                if (dropped[t]) nDropped++;
+            }
+            if (nDropped) dropTracks(&anim, dropped);
+        }
+        anim.additive = true;
+        printf("Animation %s: additive, %d of %d channels stay at the bind pose and are dropped\n",
+               anim.id.c_str(), nDropped, nChannels);
+    }
+}
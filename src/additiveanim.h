@@ -0,0 +1,17 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_ADDITIVEANIM_H
+#define PB_FBX_CONV_ADDITIVEANIM_H
+
+#include "model.h"
+#include "args.h"
+
+// With opts->additiveAnimations and p3db output, rewrites every animation relative to the local transform of each
+// node: translations become t - bind, rotations inverse(bind) * r and scales s / bind, per component. Channels that
+// stay within opts->animError (or the larger -k errors) of identity are dropped, and nodes left without channels
+// are removed. Animations of a node with a zero bind scale component and a non zero animated one stay absolute.
+void makeAnimationsAdditive(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_ADDITIVEANIM_H
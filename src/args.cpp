@@ -5,20 +5,55 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <climits>
 #include "args.h"
+#include "quantizemesh.h"
 
 static void printHelp(const char *programName) {
     printf("Usage: %s [options] filename [outfile]\n", programName);
     printf("Options:\n");
-    printf("  -m maxVerts   limit the max number of vertices in a [m]esh (default 32768)\n");
+    printf("  -m maxVerts   limit the max number of vertices in a [m]esh (default 32768, unlimited with -u)\n");
+    printf("  -u            write the smallest [u]nsigned index type for each mesh part (8, 16 or 32 bits),\n");
+    printf("                and allow meshes with more than 65536 vertices\n");
     printf("  -b maxBones   limit the max number of [b]ones in a draw call (default 12)\n");
     printf("  -w maxWeights limit the max number of bone [w]eights per vertex (default 4)\n");
+    printf("  -i            split skinned mesh parts by [i]nfluence count, so vertices only carry the 1, 2 or\n");
+    printf("                maxWeights blend weights they need\n");
+    printf("  -R            convert [R]igidly skinned triangles (every vertex fully bound to one bone) into\n");
+    printf("                static parts attached to that bone's node\n");
+    printf("  -B            [B]atch static meshes: bake node transforms into the vertices and merge parts that\n");
+    printf("                share a material into one node\n");
     printf("  -f            [f]lip the V texture axis\n");
     printf("  -p            [p]ack vertex colors into 4 bytes\n");
+    printf("  -c            reorder triangles and vertices for the post-transform vertex [c]ache\n");
+    printf("  -l levels     generate up to this many simplified [l]evels of detail for each mesh part (default 0)\n");
+    printf("  -L ratio      triangle ratio between successive [L]ODs (default 0.5)\n");
+    printf("  -E error      max LOD simplification [E]rror as a fraction of the mesh size (default 0.02)\n");
+    printf("  -t            output [t]riangle strips for mesh parts where they are smaller than lists\n");
+    printf("  -O threshold  after -c, reorder triangle clusters to reduce [O]verdraw. threshold >= 1 is the\n");
+    printf("                allowed ACMR growth per cluster, larger values trade cache hits for less overdraw (try 1.05)\n");
+    printf("  -q profile    [q]uantize vertex attributes. Profiles are none, half (half float positions and uvs),\n");
+    printf("                norm16 (16 bit positions and uvs within the mesh bounds) and compact (norm16 with\n");
+    printf("                8 bit normals). Normals and tangents are octahedral encoded, colors use 8 bits.\n");
+    printf("  -W bits       pack blend [W]eights as u8 bone indices and 8 or 16 bit normalized weights\n");
     printf("  -j            output g3d[j] instead of g3db\n");
     printf("  -r samplerate frame [r]ate at which to sample animations\n");
     printf("  -s playspeed  animation playback [s]peed, will be used to scale the sample rate\n");
     printf("  -a            output p3db [a]nimations instead of g3db\n");
+    printf("  -T threads    number of [T]hreads used to sample animations (default 0, one per core)\n");
+    printf("  -K            write the source animation [K]eys as tracks instead of sampling at a fixed rate\n");
+    printf("  -S            [S]trip the animation of nodes that influence nothing: no parts, not a bone and no\n");
+    printf("                descendant that is either\n");
+    printf("  -N names      with -S, keep the animation of these comma separated [N]odes and their ancestors\n");
+    printf("  -k error      remove animation [k]eys that interpolation reproduces within this distance, and\n");
+    printf("                write every channel as a track with its own key times\n");
+    printf("  -g degrees    max an[g]ular error for rotation keys removed by -k or quantized by -z (default 0.1)\n");
+    printf("  -z error      compress p3db animation tracks, quantizing translations and scales within this\n");
+    printf("                distance and packing rotations as their smallest three components\n");
+    printf("  -P            write p3db animation data in a [P]lanar layout, each component contiguous across frames\n");
+    printf("  -D            [D]eduplicate p3db animations, writing identical takes as aliases and identical\n");
+    printf("                tracks as references\n");
+    printf("  -A            write p3db animations as [A]dditive offsets from each node's local transform\n");
     printf("  -h or -?      display this [h]elp message and exit\n");
 	printf("  -v            legacy flag, its [v]alue is ignored.\n");
     printf("  -o ignored    legacy flag, its value is ign[o]red.\n");
@@ -32,6 +67,7 @@ static void printHelp(const char *programName) {
     printf("                  M  dump the fbx [M]eshes to the console\n");
     printf("                  g  dump the fbx [g]eometry to the console\n");
     printf("                  O  dump a .obj file containing the tesselated geometry to 'geom.obj'\n");
+    printf("                  b  [b]enchmark scalar vs SIMD vertex stream conversion\n");
 }
 
 bool parseArgs(int argc, char *argv[], Options *opts) {
@@ -68,12 +104,9 @@ bool parseArgs(int argc, char *argv[], Options *opts) {
                 } else if (maxVerts <= 3) {
                     printf("Error: max vertices must be at least 3, lest there be no triangles. (%d requested)\n", maxVerts);
                     success = false;
-                } else if (maxVerts > 65536) {
-                    printf("Error: max vertices per mesh cannot be more than 65536, since indices are 16 bits. (%d requested)\n", maxVerts);
-                    success = false;
                 } else {
+                    // the upper limit depends on -u, which may come later. It's checked after parsing.
                     if (maxVerts < 100) printf("Warning: vertices per mesh restricted to %d. This may lead to excess draw calls and decreased performance.\n", maxVerts);
-                    if (maxVerts > 32768) printf("Warning: meshes may be larger than 32768 vertices. This may lead to large indices appearing negative from java code.\n");
                     opts->maxVertices = maxVerts;
                 }
                 break;
@@ -129,6 +162,136 @@ bool parseArgs(int argc, char *argv[], Options *opts) {
                 break;
             }
 
+            case 'O': {
+                float threshold = float(atof(cc));
+                if (threshold < 1) {
+                    printf("Error: Overdraw threshold must be at least 1. (%f requested)\n", threshold);
+                    success = false;
+                } else {
+                    opts->overdrawThreshold = threshold;
+                    opts->optimizeVertexCache = true;
+                }
+                break;
+            }
+
+            case 'l': {
+                int levels = atoi(cc);
+                if (levels == 0 && cc[0] != '0') {
+                    printf("Error: couldn't parse '%s' as integer for argument -l\n", cc);
+                    goto parseError;
+                } else if (levels < 0) {
+                    printf("Error: number of LODs must not be negative. (%d requested)\n", levels);
+                    success = false;
+                } else {
+                    opts->lodLevels = levels;
+                }
+                break;
+            }
+
+            case 'L': {
+                float ratio = float(atof(cc));
+                if (ratio <= 0 || ratio >= 1) {
+                    printf("Error: LOD triangle ratio must be between 0 and 1. (%f requested)\n", ratio);
+                    success = false;
+                } else {
+                    opts->lodRatio = ratio;
+                }
+                break;
+            }
+
+            case 'E': {
+                float error = float(atof(cc));
+                if (error <= 0) {
+                    printf("Error: LOD error must be positive. (%f requested)\n", error);
+                    success = false;
+                } else {
+                    opts->lodMaxError = error;
+                }
+                break;
+            }
+
+            case 'q': {
+                int profile = -1;
+                for (int c = 0; c < QUANTIZE_PROFILE_COUNT; c++) {
+                    if (strcmp(cc, quantizationProfileNames[c]) == 0) profile = c;
+                }
+                if (profile < 0) {
+                    printf("Error: unknown quantization profile '%s'\n", cc);
+                    success = false;
+                } else {
+                    opts->quantization = profile;
+                }
+                break;
+            }
+
+            case 'W': {
+                int bits = atoi(cc);
+                if (bits != 8 && bits != 16) {
+                    printf("Error: packed blend weights must be 8 or 16 bits. ('%s' requested)\n", cc);
+                    success = false;
+                } else {
+                    opts->packedWeightBits = bits;
+                }
+                break;
+            }
+
+            case 'T': {
+                int threads = atoi(cc);
+                if ((threads == 0 && cc[0] != '0') || threads < 0) {
+                    printf("Error: couldn't parse '%s' as a thread count for argument -T\n", cc);
+                    goto parseError;
+                } else {
+                    opts->threads = threads;
+                }
+                break;
+            }
+
+            case 'k': {
+                float error = float(atof(cc));
+                if (error <= 0) {
+                    printf("Error: Keyframe error must be positive. (%f requested)\n", error);
+                    success = false;
+                } else {
+                    opts->keyError = error;
+                }
+                break;
+            }
+
+            case 'g': {
+                float degrees = float(atof(cc));
+                if (degrees <= 0) {
+                    printf("Error: Keyframe angular error must be positive. (%f requested)\n", degrees);
+                    success = false;
+                } else {
+                    opts->keyAngleError = degrees;
+                }
+                break;
+            }
+
+            case 'z': {
+                float error = float(atof(cc));
+                if (error <= 0) {
+                    printf("Error: Animation compression error must be positive. (%f requested)\n", error);
+                    success = false;
+                } else {
+                    opts->compressError = error;
+                }
+                break;
+            }
+
+            case 'N': {
+                std::string names(cc);
+                size_t begin = 0;
+                while (begin <= names.size()) {
+                    size_t end = names.find(',', begin);
+                    if (end == std::string::npos) end = names.size();
+                    if (end > begin) opts->keepNodes.push_back(names.substr(begin, end - begin));
+                    begin = end + 1;
+                }
+                opts->stripUnusedNodes = true;
+                break;
+            }
+
             case 'd': {
                 while (*cc) {
                     switch (*cc) {
@@ -153,6 +316,9 @@ bool parseArgs(int argc, char *argv[], Options *opts) {
                     case 'O':
                         opts->dumpObj = true;
                         break;
+                    case 'b':
+                        opts->benchStreams = true;
+                        break;
                     default:
                         printf("Ignoring unknown debug flag: '%c' (%d)\n", *cc, *cc);
                         break;
@@ -190,9 +356,42 @@ bool parseArgs(int argc, char *argv[], Options *opts) {
         case 'f':
             opts->flipV = true;
             break;
+        case 'u':
+            opts->wideIndices = true;
+            break;
+        case 'i':
+            opts->splitInfluences = true;
+            break;
+        case 'R':
+            opts->rigidParts = true;
+            break;
+        case 'B':
+            opts->staticBatching = true;
+            break;
+        case 'K':
+            opts->sourceKeys = true;
+            break;
+        case 'S':
+            opts->stripUnusedNodes = true;
+            break;
+        case 'P':
+            opts->planarAnimations = true;
+            break;
+        case 'D':
+            opts->dedupAnimations = true;
+            break;
+        case 'A':
+            opts->additiveAnimations = true;
+            break;
         case 'p':
             opts->packVertexColors = true;
             break;
+        case 'c':
+            opts->optimizeVertexCache = true;
+            break;
+        case 't':
+            opts->triangleStrips = true;
+            break;
         case 'j':
             opts->useJson = true;
             break;
@@ -225,6 +424,15 @@ bool parseArgs(int argc, char *argv[], Options *opts) {
         success = false;
     }
 
+    if (opts->maxVertices == 0) {
+        opts->maxVertices = opts->wideIndices ? INT_MAX : 32767;
+    } else if (!opts->wideIndices && opts->maxVertices > 65536) {
+        printf("Error: max vertices per mesh cannot be more than 65536, since indices are 16 bits. Use -u for 32 bit indices. (%d requested)\n", opts->maxVertices);
+        success = false;
+    } else if (!opts->wideIndices && opts->maxVertices > 32768) {
+        printf("Warning: meshes may be larger than 32768 vertices. This may lead to large indices appearing negative from java code.\n");
+    }
+
     if (!success) {
         printHelp(argv[0]);
     } else {
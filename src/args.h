@@ -11,15 +11,37 @@ struct Options {
     char *filepath = nullptr;
     char *outpath = nullptr;
 
-    int maxVertices = 32767;
+    int maxVertices = 0; // 0 picks the default for the index width, 32767 or unlimited with -u
+    bool wideIndices = false;
     int maxDrawBones = 12;
     int maxBlendWeights = 4;
+    bool splitInfluences = false;
+    bool rigidParts = false;
+    bool staticBatching = false;
     bool flipV = false;
     bool packVertexColors = false;
+    bool optimizeVertexCache = false;
+    float overdrawThreshold = 0; // 0 disables overdraw optimization
+    bool triangleStrips = false;
+    int lodLevels = 0;
+    float lodRatio = 0.5f;
+    float lodMaxError = 0.02f;
+    int quantization = 0; // QUANTIZE_NONE
+    int packedWeightBits = 0; // 0 keeps float blend weights
     double animFramerate = 15.0;
     double animPlaySpeed = 1.0;
     double animSamplingRate = 1.0 / 15.0;
     float animError = 0.0001;
+    int threads = 0; // 0 uses one thread per core
+    bool sourceKeys = false;
+    bool stripUnusedNodes = false;
+    std::vector<std::string> keepNodes;
+    float keyError = 0; // 0 disables keyframe reduction
+    float keyAngleError = 0.1f; // degrees
+    float compressError = 0; // 0 disables animation compression
+    bool planarAnimations = false;
+    bool dedupAnimations = false;
+    bool additiveAnimations = false;
 
     bool useJson = false;
     bool p3db = false;
@@ -31,6 +53,7 @@ struct Options {
     bool dumpMeshes = false;
     bool dumpGeom = false;
     bool dumpObj = false;
+    bool benchStreams = false;
 };
 
 bool parseArgs(int argc, char *argv[], Options *opts);
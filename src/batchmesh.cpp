@@ -0,0 +1,274 @@
+//
+// Created on 10/18/26.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "batchmesh.h"
+#include "convertfbx.h"
+#include "mathutil.h"
+
+using namespace ofbx;
+
+#define ALL_BLENDWEIGHTS (ATTR_BLENDWEIGHT0 * 0xFF)
+
+struct PartRef {
+    int mesh;
+    int part;
+};
+
+struct BatchMember {
+    Node *node;
+    int nodePart;
+    PartRef source;
+};
+
+struct BatchGroup {
+    Attributes attributes;
+    std::string materialID;
+    std::vector<BatchMember> members;
+};
+
+static void collectStaticParts(std::vector<Node> &nodes, bool animatedParent, const std::unordered_set<std::string> &animated,
+                               const std::unordered_map<std::string, PartRef> &partRefs, Model *model,
+                               std::vector<BatchGroup> &groups) {
+    for (Node &node : nodes) {
+        bool isAnimated = animatedParent || animated.count(node.id) != 0;
+        if (!isAnimated) {
+            for (int c = 0, n = int(node.parts.size()); c < n; c++) {
+                NodePart &np = node.parts[c];
+                if (!np.bones.empty()) continue;
+                auto ref = partRefs.find(np.meshPartID);
+                if (ref == partRefs.end()) continue;
+                ModelMesh &mesh = model->meshes[ref->second.mesh];
+                if (mesh.attributes & ALL_BLENDWEIGHTS) continue;
+                if (mesh.parts[ref->second.part].primitive != PRIMITIVETYPE_TRIANGLES) continue;
+
+                BatchGroup *group = nullptr;
+                for (BatchGroup &candidate : groups) {
+                    if (candidate.attributes == mesh.attributes && candidate.materialID == np.materialID) {
+                        group = &candidate;
+                        break;
+                    }
+                }
+                if (!group) {
+                    groups.emplace_back();
+                    group = &groups.back();
+                    group->attributes = mesh.attributes;
+                    group->materialID = np.materialID;
+                }
+                group->members.push_back({&node, c, ref->second});
+            }
+        }
+        collectStaticParts(node.children, isAnimated, animated, partRefs, model, groups);
+    }
+}
+
+static void collectReferences(const std::vector<Node> &nodes, std::unordered_set<std::string> &meshParts,
+                              std::unordered_set<std::string> &boneNodes) {
+    for (const Node &node : nodes) {
+        for (const NodePart &np : node.parts) {
+            meshParts.insert(np.meshPartID);
+            for (const BoneBinding &bone : np.bones) {
+                boneNodes.insert(bone.nodeID);
+            }
+        }
+        collectReferences(node.children, meshParts, boneNodes);
+    }
+}
+
+static void transformVertex(float *v, const Matrix *transform, bool direction) {
+    Vec3 in = {v[0], v[1], v[2]};
+    Vec3 out = mul(transform, in);
+    if (direction) normalize(&out);
+    v[0] = float(out.x);
+    v[1] = float(out.y);
+    v[2] = float(out.z);
+}
+
+// Number of distinct vertices referenced by a part, an upper bound on what it adds to a batch mesh.
+static u32 countPartVertices(const ModelMesh *mesh, const MeshPart *part) {
+    std::vector<bool> used(mesh->vertices.size() / mesh->vertexSize, false);
+    u32 count = 0;
+    for (u32 index : part->indices) {
+        if (!used[index]) {
+            used[index] = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Rebuilds the vertex array from the vertices the remaining parts reference, in order of first use.
+static void compactMesh(ModelMesh *mesh) {
+    ModelMesh compacted;
+    compacted.attributes = mesh->attributes;
+    compacted.vertexSize = mesh->vertexSize;
+    for (MeshPart &part : mesh->parts) {
+        for (u32 &index : part.indices) {
+            index = addVertex(&compacted, &mesh->vertices[index * mesh->vertexSize]);
+        }
+    }
+    mesh->vertices.swap(compacted.vertices);
+    mesh->vertexLookup.swap(compacted.vertexLookup);
+}
+
+// Removes the nodes in emptied that have no parts or children left and aren't referenced by a bone.
+static void pruneNodes(std::vector<Node> &nodes, const std::unordered_set<Node *> &emptied,
+                       const std::unordered_set<std::string> &boneNodes) {
+    for (int c = int(nodes.size()) - 1; c >= 0; c--) {
+        Node *node = &nodes[c];
+        pruneNodes(node->children, emptied, boneNodes);
+        if (node->parts.empty() && node->children.empty() && emptied.count(node) && !boneNodes.count(node->id)) {
+            nodes.erase(nodes.begin() + c);
+        }
+    }
+}
+
+void batchStaticMeshes(Model *model, Options *opts) {
+    if (!opts->staticBatching) return;
+
+    std::unordered_set<std::string> animated;
+    for (Animation &anim : model->animations) {
+        animated.insert(anim.nodeIDs.begin(), anim.nodeIDs.end());
+    }
+    std::unordered_map<std::string, PartRef> partRefs;
+    for (int m = 0, nMeshes = int(model->meshes.size()); m < nMeshes; m++) {
+        for (int p = 0, nParts = int(model->meshes[m].parts.size()); p < nParts; p++) {
+            partRefs[model->meshes[m].parts[p].id] = {m, p};
+        }
+    }
+
+    std::vector<BatchGroup> groups;
+    collectStaticParts(model->nodes, false, animated, partRefs, model, groups);
+
+    // Build the batch meshes. Source meshes are only read here, and are cleaned up below.
+    int nSourceMeshes = int(model->meshes.size());
+    std::unordered_map<Attributes, int> currentMesh; // attributes -> batch mesh being filled
+    std::vector<NodePart> batchParts;
+    std::unordered_set<Node *> emptied;
+    std::unordered_set<std::string> batchedSources;
+    std::unordered_set<int> touchedMeshes;
+    int nBatched = 0;
+    float vertex[MAX_VERTEX_SIZE];
+    for (BatchGroup &group : groups) {
+        if (group.members.size() < 2) continue;
+
+        u16 vSize = calculateVertexSize(group.attributes);
+        int normalOffset = (group.attributes & ATTR_NORMAL) ? calculateVertexOffset(group.attributes, ATTR_NORMAL) : -1;
+        int tangentOffset = (group.attributes & ATTR_TANGENT) ? calculateVertexOffset(group.attributes, ATTR_TANGENT) : -1;
+        int binormalOffset = (group.attributes & ATTR_BINORMAL) ? calculateVertexOffset(group.attributes, ATTR_BINORMAL) : -1;
+
+        MeshPart *out = nullptr;
+        int outMesh = -1;
+        for (BatchMember &member : group.members) {
+            const ModelMesh *source = &model->meshes[member.source.mesh];
+            const MeshPart *sourcePart = &source->parts[member.source.part];
+            u32 nVerts = countPartVertices(source, sourcePart);
+            if (nVerts > u32(opts->maxVertices)) continue;
+
+            auto current = currentMesh.find(group.attributes);
+            if (current == currentMesh.end() ||
+                model->meshes[current->second].vertices.size() / vSize + nVerts > u32(opts->maxVertices)) {
+                model->meshes.emplace_back();
+                ModelMesh *mesh = &model->meshes.back();
+                mesh->attributes = group.attributes;
+                mesh->vertexSize = vSize;
+                currentMesh[group.attributes] = int(model->meshes.size()) - 1;
+                // meshes may have moved
+                source = &model->meshes[member.source.mesh];
+                sourcePart = &source->parts[member.source.part];
+            }
+            ModelMesh *mesh = &model->meshes[currentMesh[group.attributes]];
+            if (outMesh != currentMesh[group.attributes]) {
+                outMesh = currentMesh[group.attributes];
+                mesh->parts.emplace_back();
+                out = &mesh->parts.back();
+                out->id = "StaticBatch_" + std::to_string(batchParts.size());
+                out->primitive = PRIMITIVETYPE_TRIANGLES;
+
+                batchParts.emplace_back();
+                batchParts.back().meshPartID = out->id;
+                batchParts.back().materialID = group.materialID;
+            }
+
+            Matrix transform = member.node->source->getGlobalTransform();
+            Matrix normalTf, directionTf = transform;
+            calculateNormalFromTransform(&transform, &normalTf);
+            directionTf.m[12] = directionTf.m[13] = directionTf.m[14] = 0;
+            const double *m = transform.m;
+            double det = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[4] * (m[1] * m[10] - m[2] * m[9]) + m[8] * (m[1] * m[6] - m[2] * m[5]);
+
+            size_t first = out->indices.size();
+            for (u32 index : sourcePart->indices) {
+                memcpy(vertex, &source->vertices[index * vSize], vSize * sizeof(float));
+                if (group.attributes & ATTR_POSITION) transformVertex(vertex, &transform, false);
+                if (normalOffset >= 0) transformVertex(&vertex[normalOffset], &normalTf, true);
+                if (tangentOffset >= 0) transformVertex(&vertex[tangentOffset], &directionTf, true);
+                if (binormalOffset >= 0) transformVertex(&vertex[binormalOffset], &directionTf, true);
+                out->indices.push_back(addVertex(mesh, vertex));
+            }
+            // mirroring transforms flip the winding
+            if (det < 0) {
+                for (size_t c = first; c + 2 < out->indices.size(); c += 3) {
+                    std::swap(out->indices[c + 1], out->indices[c + 2]);
+                }
+            }
+
+            member.node->parts[member.nodePart].meshPartID.clear(); // marks the node part for removal
+            emptied.insert(member.node);
+            batchedSources.insert(sourcePart->id);
+            touchedMeshes.insert(member.source.mesh);
+            nBatched++;
+        }
+    }
+    if (nBatched == 0) {
+        printf("Static batching: nothing to merge\n");
+        return;
+    }
+
+    // drop the batched node parts, then the mesh parts nothing references anymore
+    for (Node *node : emptied) {
+        std::vector<NodePart> &parts = node->parts;
+        std::vector<NodePart> remaining;
+        for (NodePart &np : parts) {
+            if (!np.meshPartID.empty()) remaining.push_back(std::move(np));
+        }
+        parts.swap(remaining);
+    }
+    std::unordered_set<std::string> referenced, boneNodes;
+    collectReferences(model->nodes, referenced, boneNodes);
+    for (int m : touchedMeshes) {
+        ModelMesh &mesh = model->meshes[m];
+        std::vector<MeshPart> remaining;
+        for (MeshPart &part : mesh.parts) {
+            if (!batchedSources.count(part.id) || referenced.count(part.id)) remaining.push_back(std::move(part));
+        }
+        if (remaining.size() == mesh.parts.size()) continue;
+        mesh.parts.swap(remaining);
+        if (!mesh.parts.empty()) compactMesh(&mesh);
+    }
+    for (int m = nSourceMeshes - 1; m >= 0; m--) {
+        if (model->meshes[m].parts.empty()) model->meshes.erase(model->meshes.begin() + m);
+    }
+
+    int nNodes = int(emptied.size());
+    pruneNodes(model->nodes, emptied, boneNodes);
+
+    model->nodes.emplace_back();
+    Node *batch = &model->nodes.back();
+    batch->source = nullptr;
+    batch->id = "StaticBatch";
+    batch->translation[0] = batch->translation[1] = batch->translation[2] = 0;
+    batch->rotation[0] = batch->rotation[1] = batch->rotation[2] = 0;
+    batch->rotation[3] = 1;
+    batch->scale[0] = batch->scale[1] = batch->scale[2] = 1;
+    batch->parts.swap(batchParts);
+
+    printf("Static batching: merged %d parts from %d nodes into %d parts\n", nBatched, nNodes, int(batch->parts.size()));
+}
@@ -0,0 +1,17 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_BATCHMESH_H
+#define PB_FBX_CONV_BATCHMESH_H
+
+#include "model.h"
+#include "args.h"
+
+// With opts->staticBatching, bakes the global transform of every node that isn't animated (and has no animated
+// ancestor) into copies of its unskinned triangle parts, and merges the copies that share a material and vertex
+// attributes into parts on a single "StaticBatch" root node. Each batch mesh stays within opts->maxVertices.
+// Groups with a single part are left alone. Nodes that end up empty are removed unless something references them.
+void batchStaticMeshes(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_BATCHMESH_H
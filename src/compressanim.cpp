@@ -0,0 +1,224 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "compressanim.h"
+#include "reduceanim.h"
+
+static const float smallestThreeRange = 0.70710678f; // 1/sqrt(2), the largest a component other than the largest can be
+
+
+// ---------------------- Encodings ------------------------
+
+int encodeSmallestThree(const float *quat, float *out) {
+    int largest = 0;
+    for (int c = 1; c < 4; c++) {
+        if (fabsf(quat[c]) > fabsf(quat[largest])) largest = c;
+    }
+    float sign = quat[largest] < 0 ? -1.0f : 1.0f;
+    for (int c = 0, d = 0; c < 4; c++) {
+        if (c != largest) out[d++] = quat[c] * sign;
+    }
+    return largest;
+}
+
+void decodeSmallestThree(int largest, const float *smallest, float *quat) {
+    float sum = 0;
+    for (int c = 0, d = 0; c < 4; c++) {
+        if (c == largest) continue;
+        quat[c] = smallest[d++];
+        sum += quat[c] * quat[c];
+    }
+    quat[largest] = sqrtf(fmaxf(0.0f, 1.0f - sum));
+}
+
+static inline u32 quantize(float value, float min, float extent, u32 maxValue) {
+    if (extent <= 0) return 0;
+    float scaled = (value - min) / extent * maxValue + 0.5f;
+    if (scaled <= 0) return 0;
+    if (scaled >= maxValue) return maxValue;
+    return u32(scaled);
+}
+
+static inline float dequantize(u32 value, float min, float extent, u32 maxValue) {
+    return min + extent * value / maxValue;
+}
+
+struct BitWriter {
+    std::vector<u8> *out;
+    u64 pending = 0;
+    int nPending = 0;
+
+    void write(u32 value, int bits) {
+        pending |= u64(value) << nPending;
+        nPending += bits;
+        while (nPending >= 8) {
+            out->push_back(u8(pending));
+            pending >>= 8;
+            nPending -= 8;
+        }
+    }
+    void flush() {
+        if (nPending > 0) out->push_back(u8(pending));
+        pending = 0;
+        nPending = 0;
+    }
+};
+
+static u32 readBits(const std::vector<u8> &data, u64 bitOffset, int bits) {
+    u32 value = 0;
+    for (int c = 0; c < bits; c++, bitOffset++) {
+        value |= u32((data[bitOffset >> 3] >> (bitOffset & 7)) & 1) << c;
+    }
+    return value;
+}
+
+
+// ---------------------- Tracks ------------------------
+
+static inline int channelWidth(u32 channel) {
+    return channel == CHANNEL_ROTATION ? 4 : 3;
+}
+
+static inline u32 keyBits(const AnimationTrack *track) {
+    return track->channel == CHANNEL_ROTATION ? 2 + 3 * track->bits : 3 * track->bits;
+}
+
+static void packTrack(AnimationTrack *track) {
+    u32 maxValue = (1u << track->bits) - 1;
+    int width = channelWidth(track->channel);
+    u32 nKeys = u32(track->times.size());
+    track->packed.clear();
+    track->packed.reserve((u64(keyBits(track)) * nKeys + 7) / 8);
+    BitWriter writer;
+    writer.out = &track->packed;
+    for (u32 k = 0; k < nKeys; k++) {
+        const float *value = &track->values[k * width];
+        if (track->channel == CHANNEL_ROTATION) {
+            float len = sqrtf(value[0]*value[0] + value[1]*value[1] + value[2]*value[2] + value[3]*value[3]);
+            float quat[4] = {value[0] / len, value[1] / len, value[2] / len, value[3] / len};
+            float smallest[3];
+            int largest = encodeSmallestThree(quat, smallest);
+            writer.write(u32(largest), 2);
+            for (int c = 0; c < 3; c++) {
+                writer.write(quantize(smallest[c], track->min[c], track->extent[c], maxValue), track->bits);
+            }
+        } else {
+            for (int c = 0; c < 3; c++) {
+                writer.write(quantize(value[c], track->min[c], track->extent[c], maxValue), track->bits);
+            }
+        }
+    }
+    writer.flush();
+}
+
+void decompressKey(const AnimationTrack *track, u32 key, float *out) {
+    u32 maxValue = (1u << track->bits) - 1;
+    u64 offset = u64(keyBits(track)) * key;
+    if (track->channel == CHANNEL_ROTATION) {
+        int largest = int(readBits(track->packed, offset, 2));
+        offset += 2;
+        float smallest[3];
+        for (int c = 0; c < 3; c++, offset += track->bits) {
+            smallest[c] = dequantize(readBits(track->packed, offset, track->bits), track->min[c], track->extent[c], maxValue);
+        }
+        decodeSmallestThree(largest, smallest, out);
+    } else {
+        for (int c = 0; c < 3; c++, offset += track->bits) {
+            out[c] = dequantize(readBits(track->packed, offset, track->bits), track->min[c], track->extent[c], maxValue);
+        }
+    }
+}
+
+// Fills in min and extent of the smallest three components of the track's rotations.
+static void fitRotationRange(AnimationTrack *track) {
+    u32 nKeys = u32(track->times.size());
+    float lo[3] = {smallestThreeRange, smallestThreeRange, smallestThreeRange};
+    float hi[3] = {-smallestThreeRange, -smallestThreeRange, -smallestThreeRange};
+    for (u32 k = 0; k < nKeys; k++) {
+        const float *value = &track->values[k * 4];
+        float len = sqrtf(value[0]*value[0] + value[1]*value[1] + value[2]*value[2] + value[3]*value[3]);
+        float quat[4] = {value[0] / len, value[1] / len, value[2] / len, value[3] / len};
+        float smallest[3];
+        encodeSmallestThree(quat, smallest);
+        for (int c = 0; c < 3; c++) {
+            lo[c] = fminf(lo[c], smallest[c]);
+            hi[c] = fmaxf(hi[c], smallest[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        track->min[c] = lo[c];
+        track->extent[c] = hi[c] - lo[c];
+    }
+}
+
+bool compressTrack(AnimationTrack *track, float maxError, bool rotationRange) {
+    int width = channelWidth(track->channel);
+    u32 nKeys = u32(track->times.size());
+    if (track->channel == CHANNEL_ROTATION) {
+        if (rotationRange) {
+            fitRotationRange(track);
+        } else {
+            for (int c = 0; c < 3; c++) {
+                track->min[c] = -smallestThreeRange;
+                track->extent[c] = 2 * smallestThreeRange;
+            }
+        }
+    } else {
+        for (int c = 0; c < 3; c++) {
+            float lo = track->values[c], hi = track->values[c];
+            for (u32 k = 1; k < nKeys; k++) {
+                lo = fminf(lo, track->values[k * 3 + c]);
+                hi = fmaxf(hi, track->values[k * 3 + c]);
+            }
+            track->min[c] = lo;
+            track->extent[c] = hi - lo;
+        }
+    }
+
+    // try each width until every key decodes within the error
+    for (u32 bits = MIN_TRACK_BITS; bits <= MAX_TRACK_BITS; bits++) {
+        track->bits = bits;
+        packTrack(track);
+        bool fits = true;
+        float decoded[4];
+        for (u32 k = 0; k < nKeys && fits; k++) {
+            decompressKey(track, k, decoded);
+            fits = trackKeyError(track->channel, &track->values[k * width], decoded) <= maxError;
+        }
+        if (fits) {
+            track->compressed = true;
+            return true;
+        }
+    }
+    track->bits = 0;
+    track->packed.clear();
+    for (int c = 0; c < 3; c++) track->min[c] = track->extent[c] = 0;
+    return false;
+}
+
+void compressAnimations(Model *model, Options *opts) {
+    if (opts->compressError <= 0) return;
+    float angleError = float(opts->keyAngleError * M_PI / 180.0);
+    for (Animation &anim : model->animations) {
+        buildTracks(&anim);
+        size_t before = 0, after = 0;
+        int nFailed = 0;
+        for (AnimationTrack &track : anim.tracks) {
+            size_t bytes = track.values.size() * sizeof(float);
+            before += bytes;
+            if (compressTrack(&track, track.channel == CHANNEL_ROTATION ? angleError : opts->compressError, anim.additive)) {
+                after += track.packed.size();
+            } else {
+                after += bytes;
+                nFailed++;
+            }
+        }
+        printf("Animation %s: compressed %d bytes of keys to %d", anim.id.c_str(), int(before), int(after));
+        if (nFailed) printf(", %d tracks need more than %d bits and stay uncompressed", nFailed, MAX_TRACK_BITS);
+        printf("\n");
+    }
+}
@@ -0,0 +1,34 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_COMPRESSANIM_H
+#define PB_FBX_CONV_COMPRESSANIM_H
+
+#include "model.h"
+#include "args.h"
+
+#define MIN_TRACK_BITS  4
+#define MAX_TRACK_BITS  16
+
+// Smallest three quaternion encoding. The largest component is dropped and the sign of the quaternion is chosen to
+// make it positive. The other three are in [-1/sqrt(2), 1/sqrt(2)] and are written in x, y, z, w order.
+// Returns the index of the dropped component.
+int encodeSmallestThree(const float *quat, float *out);
+void decodeSmallestThree(int largest, const float *smallest, float *quat);
+
+// Quantizes the track's values with the fewest bits (between MIN_TRACK_BITS and MAX_TRACK_BITS) that keep every key
+// within maxError, distance for translations and scales and radians for rotations, and fills in AnimationTrack::packed.
+// Keys are packed LSB first. Rotation keys are a 2 bit largest component index followed by the three smallest, each
+// as an unsigned value scaled from [-1/sqrt(2), 1/sqrt(2)]. Translation and scale keys are three unsigned values
+// scaled from [min, min + extent]. With rotationRange, so are the three smallest rotation components, with min and
+// extent fitted to the track. Returns false and leaves the track alone if MAX_TRACK_BITS isn't enough.
+bool compressTrack(AnimationTrack *track, float maxError, bool rotationRange);
+// Decodes key index key of a compressed track into out.
+void decompressKey(const AnimationTrack *track, u32 key, float *out);
+
+// With opts->compressError, converts every animation to tracks and compresses them within opts->compressError,
+// and opts->keyAngleError degrees for rotations.
+void compressAnimations(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_COMPRESSANIM_H
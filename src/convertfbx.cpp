@@ -2,15 +2,20 @@
 // Created by Martin Wickham on 8/26/17.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
 #include <cmath>
 #include <sstream>
 #include <cstring>
 #include <strings.h>
 #include <cstdio>
 #include <cstdlib>
+#include <thread>
 #include "convertfbx.h"
 #include "dumpfbx.h"
 #include "mathutil.h"
+#include "vertexstreams.h"
 
 using namespace ofbx;
 
@@ -109,6 +114,8 @@ static int getFloats(float *buf, int num, const IElementProperty *prop) {
 struct PreMeshPart {
     int nodes[MAX_DRAW_BONES];
     int material;
+    int influences = 0; // blend weights per vertex
+    int rigidBone = -1; // cluster index if every vertex is bound only to this bone
     PreMeshPart(int material) : material(material) {
         memset(nodes, -1, sizeof(nodes));
     }
@@ -131,6 +138,12 @@ struct MeshData {
     const Vec3 *tangents;
     const int *materials;
     const Skin *skin;
+    float *positionData = nullptr;
+    float *normalData = nullptr;
+    float *texCoordData = nullptr;
+    float *colorData = nullptr;
+    u32 *packedColorData = nullptr;
+    float *tangentData = nullptr;
     int nBlendWeights = 0;
     int nDrawBones = 0;
     BlendWeight *blendWeights = nullptr;
@@ -138,6 +151,13 @@ struct MeshData {
     std::vector<PreMeshPart> parts;
 };
 
+// The node parts built for an unskinned geometry, reused by every other mesh node with the same geometry and materials.
+struct MeshInstance {
+    const Geometry *geometry;
+    std::vector<const Material *> materials;
+    std::vector<NodePart> parts;
+};
+
 
 // ---------------------- Materials ------------------------
 
@@ -309,6 +329,55 @@ static void convertMaterial(const Material *mat, ModelMaterial *out) {
     }
 }
 
+static bool sameTexture(const ModelTexture &a, const ModelTexture &b) {
+    return a.id == b.id && a.texturePath == b.texturePath && a.usage == b.usage &&
+           !memcmp(a.uvTranslation, b.uvTranslation, sizeof(a.uvTranslation)) &&
+           !memcmp(a.uvScale, b.uvScale, sizeof(a.uvScale));
+}
+
+static bool sameMaterial(const ModelMaterial *a, const ModelMaterial *b) {
+    if (a->id != b->id || a->lambertOnly != b->lambertOnly || a->shininess != b->shininess || a->opacity != b->opacity) return false;
+    if (memcmp(a->ambient, b->ambient, sizeof(a->ambient)) || memcmp(a->diffuse, b->diffuse, sizeof(a->diffuse)) ||
+        memcmp(a->specular, b->specular, sizeof(a->specular)) || memcmp(a->emissive, b->emissive, sizeof(a->emissive))) return false;
+    if (a->textures.size() != b->textures.size()) return false;
+    for (size_t c = 0; c < a->textures.size(); c++) {
+        if (!sameTexture(a->textures[c], b->textures[c])) return false;
+    }
+    return true;
+}
+
+// Converts each fbx material once. Separate fbx materials that convert to the same name and content
+// (some exporters write a copy per mesh) are merged as well. Returns the material's id.
+static std::string findOrConvertMaterial(const Material *mat, Model *model, Options *opts) {
+    for (ModelMaterial &existing : model->materials) {
+        if (existing.source == mat) return existing.id;
+    }
+    if (opts->dumpMaterials) {
+        dumpElement(stdout, &mat->element, 2);
+        dumpElementRecursive(stdout, mat->element.getFirstChild(), 4);
+    }
+    ModelMaterial converted;
+    convertMaterial(mat, &converted);
+    converted.source = mat;
+    for (ModelMaterial &existing : model->materials) {
+        if (sameMaterial(&existing, &converted)) return existing.id;
+    }
+    model->materials.push_back(std::move(converted));
+    return model->materials.back().id;
+}
+
+static std::string findOrCreateDefaultMaterial(Model *model) {
+    const char *defaultID = "PerFbx_Default_Material";
+    for (ModelMaterial &existing : model->materials) {
+        if (existing.source == nullptr && existing.id == defaultID) return existing.id;
+    }
+    model->materials.emplace_back();
+    ModelMaterial *defaultMaterial = &model->materials.back();
+    defaultMaterial->id = defaultID;
+    defaultMaterial->lambertOnly = true;
+    return defaultMaterial->id;
+}
+
 static int findMaterialForTri(const int *materials) {
     for (int k = 0; k < 3; k++) {
         if (materials[k] >= 0) {
@@ -449,7 +518,41 @@ static int polyCompare(const void *a, const void *b) {
     return result < 0 ? -1 : 1;
 }
 
-static int findOrCreateMeshPart(std::vector<PreMeshPart> &parts, int material, BlendWeight *weights, int nVertWeights, int nDrawBones) {
+// The number of blend weights a triangle gets: nVertWeights, or the smallest class of 1, 2 or nVertWeights
+// influences that covers every vertex of the triangle when splitting by influence count.
+static int findInfluenceClass(BlendWeight *weights, int nVertWeights, bool splitInfluences) {
+    if (!splitInfluences) return nVertWeights;
+    int maxUsed = 0;
+    for (int v = 0; v < 3; v++) {
+        int used = 0;
+        for (int w = 0; w < nVertWeights; w++) {
+            if (weights[v * nVertWeights + w].index >= 0) used++;
+        }
+        if (used > maxUsed) maxUsed = used;
+    }
+    if (maxUsed <= 1) return 1 < nVertWeights ? 1 : nVertWeights;
+    if (maxUsed <= 2) return 2 < nVertWeights ? 2 : nVertWeights;
+    return nVertWeights;
+}
+
+// The cluster index that all 3 vertices of a triangle are bound to with full weight, or -1.
+static int findRigidBone(BlendWeight *weights, int nVertWeights) {
+    int bone = -1;
+    for (int v = 0; v < 3; v++) {
+        int vertBone = -1;
+        for (int w = 0; w < nVertWeights; w++) {
+            BlendWeight &weight = weights[v * nVertWeights + w];
+            if (weight.index < 0) continue;
+            if (vertBone >= 0 || weight.weight < 0.999f) return -1;
+            vertBone = weight.index;
+        }
+        if (vertBone < 0 || (bone >= 0 && vertBone != bone)) return -1;
+        bone = vertBone;
+    }
+    return bone;
+}
+
+static int findOrCreateMeshPart(std::vector<PreMeshPart> &parts, int material, BlendWeight *weights, int nVertWeights, int nDrawBones, const Options *opts) {
     // build a list of the required nodes for this poly
     const int nPolyNodes = MAX_BLEND_WEIGHTS * 3;
     PolyBlendWeight polyNodes[nPolyNodes];
@@ -492,9 +595,13 @@ static int findOrCreateMeshPart(std::vector<PreMeshPart> &parts, int material, B
         maxIdx = nDrawBones;
     }
 
+    // rigid triangles don't need blend weights at all, they become a static part under the bone's node.
+    int rigidBone = opts->rigidParts ? findRigidBone(weights, nVertWeights) : -1;
+    int influences = rigidBone >= 0 ? 0 : findInfluenceClass(weights, nVertWeights, opts->splitInfluences);
+
     // Find an existing mesh part that can accept this set of weights and material
     for (PreMeshPart &part : parts) {
-        if (part.material == material) {
+        if (part.material == material && part.influences == influences && part.rigidBone == rigidBone) {
             int combinedNodes[MAX_DRAW_BONES];
             memcpy(combinedNodes, part.nodes, sizeof(combinedNodes));
 
@@ -516,6 +623,8 @@ static int findOrCreateMeshPart(std::vector<PreMeshPart> &parts, int material, B
     // No existing mesh part that fits, time to make a new one.
     parts.emplace_back(material);
     PreMeshPart *part = &parts.back();
+    part->influences = influences;
+    part->rigidBone = rigidBone;
     for (int c = 0; c < maxIdx; c++) {
         part->nodes[c] = polyNodes[c].index;
     }
@@ -551,7 +660,7 @@ static int *assignTrisToPartsFromSkin(MeshData *data) {
             material = findMaterialForTri(materials);
         }
 
-        trisToParts[c] = findOrCreateMeshPart(data->parts, material, weights, nVertWeights, nDrawBones);
+        trisToParts[c] = findOrCreateMeshPart(data->parts, material, weights, nVertWeights, nDrawBones, data->opts);
 
         // move forward one vertex
         weights += nVertWeights * 3;
@@ -559,11 +668,30 @@ static int *assignTrisToPartsFromSkin(MeshData *data) {
     }
 
     printf("Packed %d triangles into %d mesh parts not exceeding %d bones.\n", nTris, int(data->parts.size()), nDrawBones);
+    if (data->opts->splitInfluences || data->opts->rigidParts) {
+        int classTris[MAX_BLEND_WEIGHTS + 1] = {0};
+        for (int c = 0; c < nTris; c++) {
+            classTris[data->parts[trisToParts[c]].influences]++;
+        }
+        if (classTris[0] != 0) printf("  %d triangles bound rigidly to a single bone\n", classTris[0]);
+        for (int c = 1; c <= nVertWeights; c++) {
+            if (classTris[c] != 0) printf("  %d triangles with %d blend weights\n", classTris[c], c);
+        }
+    }
     return trisToParts;
 }
 
+static Matrix calculateBindPose(const Cluster *cluster, const Matrix *geometry) {
+    // This is pretty much a total guess, but it produces the same results as the reference converter.
+    Matrix clusterLinkTransform = cluster->getTransformLinkMatrix();
+    Matrix invLinkTransform;
+    invertMatrix(&clusterLinkTransform, &invLinkTransform);
+    return mul(&invLinkTransform, geometry);
+}
+
 static void addBones(MeshData *data, PreMeshPart *part, NodePart *np, const Matrix *geometry) {
     if (part->nodes[0] < 0) return; // no bones
+    if (part->rigidBone >= 0) return; // attached to the bone's node instead
     const Skin *skin = data->skin;
     if (!skin) return;
 
@@ -572,6 +700,7 @@ static void addBones(MeshData *data, PreMeshPart *part, NodePart *np, const Matr
     while (nBonesUsed < maxBones && part->nodes[nBonesUsed] >= 0) nBonesUsed++;
 
     np->bones.resize(nBonesUsed);
+    std::vector<Matrix> bindPoses(nBonesUsed);
     for (int c = 0; c < nBonesUsed; c++) {
         BoneBinding *bone = &np->bones[c];
         int clusterIndex = part->nodes[c];
@@ -580,87 +709,125 @@ static void addBones(MeshData *data, PreMeshPart *part, NodePart *np, const Matr
         assert(link->isNode());
         findName(link, "Node", bone->nodeID);
 
-        // calculate the inverse bind pose
-        // This is pretty much a total guess, but it produces the same results as the reference converter.
-        Matrix clusterLinkTransform = cluster->getTransformLinkMatrix();
-        Matrix invLinkTransform;
-        invertMatrix(&clusterLinkTransform, &invLinkTransform);
-        Matrix bindPose = mul(&invLinkTransform, geometry);
-        Matrix invBindPose;
-        invertMatrix(&bindPose, &invBindPose);
-        extractTransform(&invBindPose, bone->translation, bone->rotation, bone->scale);
+        bindPoses[c] = calculateBindPose(cluster, geometry);
+    }
+
+    // calculate the inverse bind poses
+    std::vector<Matrix> invBindPoses(nBonesUsed);
+    std::vector<float> translations(3 * nBonesUsed), rotations(4 * nBonesUsed), scales(3 * nBonesUsed);
+    invertMatrices(bindPoses.data(), invBindPoses.data(), nBonesUsed);
+    extractTransforms(invBindPoses.data(), nBonesUsed, translations.data(), rotations.data(), scales.data());
+    for (int c = 0; c < nBonesUsed; c++) {
+        BoneBinding *bone = &np->bones[c];
+        memcpy(bone->translation, &translations[3 * c], sizeof(bone->translation));
+        memcpy(bone->rotation, &rotations[4 * c], sizeof(bone->rotation));
+        memcpy(bone->scale, &scales[3 * c], sizeof(bone->scale));
     }
 }
 
 
 // ---------------------- Vertices ------------------------
 
-static inline void fetch(float *&pos, const Vec2 &vec) {
-    pos[0] = (float) vec.x;
-    pos[1] = (float) vec.y;
-    pos += 2;
+// Converts the geometry streams to their vertex formats up front, so fetchVertex only has to copy floats around.
+static void convertStreams(MeshData *data) {
+    int attrs = data->attrs;
+    int nVerts = data->nVerts;
+    if (attrs & ATTR_POSITION) {
+        data->positionData = new float[nVerts * 3];
+        convertVec3Stream(data->positions, data->positionData, nVerts);
+    }
+    if (attrs & ATTR_NORMAL) {
+        data->normalData = new float[nVerts * 3];
+        convertVec3Stream(data->normals, data->normalData, nVerts);
+    }
+    if (attrs & ATTR_COLOR) {
+        data->colorData = new float[nVerts * 4];
+        convertVec4Stream(data->colors, data->colorData, nVerts);
+    }
+    if (attrs & ATTR_COLORPACKED) {
+        data->packedColorData = new u32[nVerts];
+        packColorStream(data->colors, data->packedColorData, nVerts);
+    }
+    if (attrs & ATTR_TANGENT) {
+        data->tangentData = new float[nVerts * 3];
+        convertVec3Stream(data->tangents, data->tangentData, nVerts);
+    }
+    if (attrs & ATTR_TEXCOORD0) {
+        data->texCoordData = new float[nVerts * 2];
+        convertVec2Stream(data->texCoords, data->texCoordData, nVerts, data->opts->flipV);
+    }
+}
+
+static void transformVec3(float *v, const Matrix *transform, bool direction) {
+    Vec3 in = {v[0], v[1], v[2]};
+    Vec3 out = mul(transform, in);
+    if (direction) normalize(&out);
+    v[0] = float(out.x);
+    v[1] = float(out.y);
+    v[2] = float(out.z);
 }
-static inline void fetch(float *&pos, const Vec3 &vec) {
-    pos[0] = (float) vec.x;
-    pos[1] = (float) vec.y;
-    pos[2] = (float) vec.z;
-    pos += 3;
+
+// Moves the vertices of a rigid part from mesh space into the bind space of its bone.
+static void transformRigidPart(MeshData *data, int partID, const Matrix *bindPose) {
+    Matrix normalTf, directionTf = *bindPose;
+    calculateNormalFromTransform(bindPose, &normalTf);
+    directionTf.m[12] = directionTf.m[13] = directionTf.m[14] = 0;
+    int nTris = data->nVerts / 3;
+    for (int c = 0; c < nTris; c++) {
+        if (data->trisToParts[c] != partID) continue;
+        for (int v = 3*c; v < 3*c + 3; v++) {
+            if (data->positionData) transformVec3(&data->positionData[v * 3], bindPose, false);
+            if (data->normalData) transformVec3(&data->normalData[v * 3], &normalTf, true);
+            if (data->tangentData) transformVec3(&data->tangentData[v * 3], &directionTf, true);
+        }
+    }
 }
-static inline void fetch(float *&pos, const Vec4 &vec) {
-    pos[0] = (float) vec.x;
-    pos[1] = (float) vec.y;
-    pos[2] = (float) vec.z;
-    pos[3] = (float) vec.w;
-    pos += 4;
+
+static inline void fetch(float *&pos, const float *stream, int vertexIndex, int width) {
+    memcpy(pos, &stream[vertexIndex * width], width * sizeof(float));
+    pos += width;
 }
 
 static void fetchVertex(MeshData *data, int vertexIndex, float *vertex, PreMeshPart *part) {
     int attrs = data->attrs;
     float *pos = vertex;
     if (attrs & ATTR_POSITION) {
-        fetch(pos, data->positions[vertexIndex]);
+        fetch(pos, data->positionData, vertexIndex, 3);
     }
 
     if (attrs & ATTR_NORMAL) {
-        fetch(pos, data->normals[vertexIndex]);
+        fetch(pos, data->normalData, vertexIndex, 3);
     }
 
     if (attrs & ATTR_COLOR) {
-        fetch(pos, data->colors[vertexIndex]);
+        fetch(pos, data->colorData, vertexIndex, 4);
     }
 
     if (attrs & ATTR_COLORPACKED) {
-        Vec4 color = data->colors[vertexIndex];
-        u8 r = u8(color.x >= 1.0 ? 255 : color.x * 256.0);
-        u8 g = u8(color.y >= 1.0 ? 255 : color.y * 256.0);
-        u8 b = u8(color.z >= 1.0 ? 255 : color.z * 256.0);
-        u8 a = u8(color.w >= 1.0 ? 255 : color.w * 256.0);
-        u32 packed = u32(a)<<24 | u32(b)<<16 | u32(g)<<8 | u32(r);
-        *pos++ = *(float *)&packed;
+        memcpy(pos++, &data->packedColorData[vertexIndex], sizeof(u32));
     }
 
     if (attrs & ATTR_TANGENT) {
-        fetch(pos, data->tangents[vertexIndex]);
+        fetch(pos, data->tangentData, vertexIndex, 3);
     }
     // TODO: Binormal
 
     // For now we only support one tex coord.
     if (attrs & ATTR_TEXCOORD0) {
-        Vec2 tc = data->texCoords[vertexIndex];
-        pos[0] = float(tc.x);
-        if (data->opts->flipV) {
-            pos[1] = float(1.0 - tc.y);
-        } else {
-            pos[1] = float(tc.y);
-        }
-        pos += 2;
+        fetch(pos, data->texCoordData, vertexIndex, 2);
     }
 
+    // parts with fewer influences than the mesh's skin only keep the used weights.
     int nVertWeights = data->nBlendWeights;
     int nDrawBones = data->nDrawBones;
+    int influences = part->influences;
+    bool compact = influences < nVertWeights;
     BlendWeight *weights = data->blendWeights + vertexIndex * nVertWeights;
-    for (int c = 0; c < nVertWeights; c++) {
+    int written = 0;
+    for (int c = 0; c < nVertWeights && written < influences; c++) {
         BlendWeight weight = weights[c];
+        if (compact && weight.index < 0) continue;
+        written++;
         if (weight.index < 0) {
             pos[0] = 0;
             pos[1] = 0;
@@ -679,21 +846,24 @@ static void fetchVertex(MeshData *data, int vertexIndex, float *vertex, PreMeshP
         }
         pos += 2;
     }
+    for (; written < influences; written++) {
+        pos[0] = 0;
+        pos[1] = 0;
+        pos += 2;
+    }
 }
 
-static u16 addVertex(ModelMesh *mesh, float *vertex) {
+u32 addVertex(ModelMesh *mesh, float *vertex) {
     int vSize = mesh->vertexSize;
 
     // hash and check for existing
     size_t end = mesh->vertices.size();
     u32 index = u32(end) / u32(vSize);
-    assert (index < 65536);
     int hash = hashVertex(vertex, vSize);
-    for (u32 c = 0, pos = 0; c < index; c++, pos += vSize) {
-        if (mesh->vertexHashes[c] == hash) {
-            if (checkVertexEquality(vertex, &mesh->vertices[pos], vSize)) {
-                return u16(c);
-            }
+    std::vector<u32> &candidates = mesh->vertexLookup[hash];
+    for (u32 c : candidates) {
+        if (checkVertexEquality(vertex, &mesh->vertices[c * vSize], vSize)) {
+            return c;
         }
     }
 
@@ -701,12 +871,12 @@ static u16 addVertex(ModelMesh *mesh, float *vertex) {
     mesh->vertices.resize(end + vSize);
     float *newVertex = &mesh->vertices[end];
     memcpy(newVertex, vertex, vSize * sizeof(float));
-    mesh->vertexHashes[index] = hash;
+    candidates.push_back(index);
 
-    return u16(index);
+    return index;
 }
 
-static void buildMesh(MeshData *data, ModelMesh *mesh, std::vector<u16> *indices, int partID, PreMeshPart *part) {
+static void buildMesh(MeshData *data, ModelMesh *mesh, std::vector<u32> *indices, int partID, PreMeshPart *part) {
     float vertex[MAX_VERTEX_SIZE];
     int nTris = data->nVerts / 3;
     int *trisToParts = data->trisToParts;
@@ -714,7 +884,7 @@ static void buildMesh(MeshData *data, ModelMesh *mesh, std::vector<u16> *indices
     for (int c = 0, v = 0; c < nTris; c++, v += 3) {
         if (trisToParts != nullptr && trisToParts[c] != partID) continue;
 
-        u16 index;
+        u32 index;
 
         fetchVertex(data, v+0, vertex, part);
         index = addVertex(mesh, vertex);
@@ -732,7 +902,7 @@ static void buildMesh(MeshData *data, ModelMesh *mesh, std::vector<u16> *indices
 
 
 
-static void convertMeshNode(const IScene *scene, const Mesh *mesh, Node *node, Model *model, Options *opts) {
+static void convertMeshNode(const IScene *scene, const Mesh *mesh, Node *node, Model *model, std::vector<MeshInstance> *instances, Options *opts) {
     if (opts->dumpMeshes) {
         dumpElement(stdout, &mesh->element, 2);
         dumpElementRecursive(stdout, mesh->element.getFirstChild(), 4);
@@ -744,6 +914,22 @@ static void convertMeshNode(const IScene *scene, const Mesh *mesh, Node *node, M
         dumpElementRecursive(stdout, geom->element.getFirstChild(), 4);
     }
 
+    // Skinned parts bind to bones relative to the node, so only unskinned geometry is shared between nodes.
+    std::vector<const Material *> meshMaterials;
+    for (int c = 0, n = mesh->getMaterialCount(); c < n; c++) {
+        meshMaterials.push_back(mesh->getMaterial(c));
+    }
+    bool instanceable = geom->getSkin() == nullptr;
+    if (instanceable) {
+        for (const MeshInstance &instance : *instances) {
+            if (instance.geometry == geom && instance.materials == meshMaterials) {
+                printf("Mesh %s instances the geometry of %s\n", &mesh->name[0], instance.parts[0].meshPartID.c_str());
+                node->parts = instance.parts;
+                return;
+            }
+        }
+    }
+
     MeshData data;
 
     data.opts = opts;
@@ -788,40 +974,58 @@ static void convertMeshNode(const IScene *scene, const Mesh *mesh, Node *node, M
     }
 
 
+    // materials are shared by every mesh that uses them
     int nMaterials = mesh->getMaterialCount();
-    size_t baseIdx = model->materials.size();
+    std::vector<std::string> materialIDs;
     if (nMaterials == 0) {
-        printf("Warning: No materials for mesh %s. Generating default material.\n", &mesh->name[0]);
-        model->materials.emplace_back();
-        ModelMaterial *defaultMaterial = &model->materials.back();
-        defaultMaterial->id = "PerFbx_Default_Material";
-        defaultMaterial->lambertOnly = true;
+        printf("Warning: No materials for mesh %s. Using the default material.\n", &mesh->name[0]);
+        materialIDs.push_back(findOrCreateDefaultMaterial(model));
     } else {
-        model->materials.reserve(baseIdx + nMaterials);
         for (int c = 0; c < nMaterials; c++) {
-            const Material *mat = mesh->getMaterial(c);
-            if (opts->dumpMaterials) {
-                dumpElement(stdout, &mat->element, 2);
-                dumpElementRecursive(stdout, mat->element.getFirstChild(), 4);
-            }
-            model->materials.emplace_back();
-            ModelMaterial *modelMaterial = &model->materials.back();
-            convertMaterial(mat, modelMaterial);
+            materialIDs.push_back(findOrConvertMaterial(mesh->getMaterial(c), model, opts));
         }
     }
 
 
-    ModelMesh *outMesh = findOrCreateMesh(model, data.attrs, data.nVerts, opts->maxVertices);
-    std::vector<float> *verts = &outMesh->vertices;
-    verts->reserve(verts->size() + data.nVerts * outMesh->vertexSize);
+    convertStreams(&data);
+
+    // Parts only carry the blend weights of their influence class, so each class goes into its own mesh.
+    // Without -i every part has all of the skin's blend weights, and this is a single mesh.
+    u32 classVerts[MAX_BLEND_WEIGHTS + 1] = {0};
+    int meshIndices[MAX_BLEND_WEIGHTS + 1];
+    if (data.trisToParts) {
+        for (int c = 0, nTris = data.nVerts / 3; c < nTris; c++) {
+            classVerts[data.parts[data.trisToParts[c]].influences] += 3;
+        }
+    } else {
+        classVerts[data.parts[0].influences] = u32(data.nVerts);
+    }
+    for (int c = 0; c <= MAX_BLEND_WEIGHTS; c++) {
+        if (classVerts[c] == 0) continue;
+        Attributes classAttrs = data.attrs & ~(ATTR_BLENDWEIGHT0 * 0xFF);
+        for (int d = 0; d < c; d++) {
+            classAttrs |= ATTR_BLENDWEIGHT0 << d;
+        }
+        ModelMesh *classMesh = findOrCreateMesh(model, classAttrs, classVerts[c], opts->maxVertices);
+        classMesh->vertices.reserve(classMesh->vertices.size() + classVerts[c] * classMesh->vertexSize);
+        meshIndices[c] = int(classMesh - &model->meshes[0]);
+    }
 
     // reify the mesh parts
     Matrix geomTf = mesh->getGeometricMatrix();
     Matrix meshTf = mesh->getGlobalTransform();
     Matrix nodeTf = mul(&meshTf, &geomTf);
-    outMesh->parts.reserve(outMesh->parts.size() + data.parts.size());
     int partID = 0;
     for (PreMeshPart &part : data.parts) {
+        ModelMesh *outMesh = &model->meshes[meshIndices[part.influences]];
+        const Object *attachTo = nullptr;
+        if (part.rigidBone >= 0) {
+            const Cluster *cluster = data.skin->getCluster(part.rigidBone);
+            Matrix bindPose = calculateBindPose(cluster, &nodeTf);
+            transformRigidPart(&data, partID, &bindPose);
+            attachTo = cluster->getLink();
+        }
+
         // make a mesh part
         outMesh->parts.emplace_back();
         MeshPart &mp = outMesh->parts.back();
@@ -840,19 +1044,33 @@ static void convertMeshNode(const IScene *scene, const Mesh *mesh, Node *node, M
         node->parts.emplace_back();
         NodePart *np = &node->parts.back();
         np->meshPartID = mp.id;
-        np->materialID = model->materials[baseIdx + part.material].id;
+        np->materialID = materialIDs[part.material];
+        np->attachTo = attachTo;
         addBones(&data, &part, np, &nodeTf);
 
         partID++;
     }
 
+    if (instanceable && !node->parts.empty()) {
+        instances->emplace_back();
+        MeshInstance &instance = instances->back();
+        instance.geometry = geom;
+        instance.materials.swap(meshMaterials);
+        instance.parts = node->parts;
+    }
 
     // delete [] nullptr is defined and has no effect.
     delete [] data.blendWeights;
     delete [] data.trisToParts;
+    delete [] data.positionData;
+    delete [] data.normalData;
+    delete [] data.texCoordData;
+    delete [] data.colorData;
+    delete [] data.packedColorData;
+    delete [] data.tangentData;
 }
 
-static void convertNode(const IScene *scene, const Object *obj, Node *node, Model *model, Options *opts) {
+static void convertNode(const IScene *scene, const Object *obj, Node *node, Model *model, std::vector<MeshInstance> *instances, Options *opts) {
     findName(obj, "Node", node->id);
     Matrix localTransform = obj->evalLocal(obj->getLocalTranslation(), obj->getLocalRotation());
     extractTransform(&localTransform, node->translation, node->rotation, node->scale);
@@ -860,21 +1078,22 @@ static void convertNode(const IScene *scene, const Object *obj, Node *node, Mode
     switch (obj->getType()) {
     case Object::Type::MESH:
         const Mesh *mesh = dynamic_cast<const Mesh *>(obj);
-        convertMeshNode(scene, mesh, node, model, opts);
+        convertMeshNode(scene, mesh, node, model, instances, opts);
         break;
     // TODO: Other object types?
     }
 }
 
-static void convertChildrenRecursive(const IScene *scene, const Object *obj, Model *model, std::vector<Node> *nodeList, Options *opts) {
+static void convertChildrenRecursive(const IScene *scene, const Object *obj, Model *model, std::vector<Node> *nodeList,
+                                     std::vector<MeshInstance> *instances, Options *opts) {
     const Object *child;
     for (int i = 0; (child = obj->resolveObjectLink(i)); i++) {
         if (child->isNode()) {
             nodeList->emplace_back();
             Node *node = &nodeList->back();
             node->source = child;
-            convertNode(scene, child, node, model, opts);
-            convertChildrenRecursive(scene, child, model, &node->children, opts);
+            convertNode(scene, child, node, model, instances, opts);
+            convertChildrenRecursive(scene, child, model, &node->children, instances, opts);
         }
     }
 }
@@ -894,33 +1113,390 @@ static bool close(float *a, float *b, int len, float epsilon) {
     return true;
 }
 
+// Calls fn(0) ... fn(count - 1) on up to threads threads (0 for one per core). Items are handed out in order.
+template <typename F>
+static void parallelFor(int count, int threads, F fn) {
+    if (threads <= 0) threads = int(std::thread::hardware_concurrency());
+    if (threads > count) threads = count;
+    if (threads <= 1) {
+        for (int c = 0; c < count; c++) fn(c);
+        return;
+    }
+    std::atomic<int> next(0);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            for (int c; (c = next++) < count;) fn(c);
+        });
+    }
+    for (std::thread &thread : pool) thread.join();
+}
+
+// ---------------------- Curves ------------------------
+
+// FBX time units per second, the same conversion AnimationCurveNode::getNodeLocalTransform uses.
+static const ofbx::u64 fbxTicksPerSecond = 46186158000L;
+
+// One component curve of an AnimationCurveNode, evaluated at increasing times like getNodeLocalTransform does,
+// but continuing from the previous key instead of searching from the first one every time.
+struct CurveCursor {
+    const ofbx::u64 *times = nullptr;
+    const float *values = nullptr;
+    int count = 0;
+    int key = 1;
+    bool constant = true;
+    float value = 0; // when constant
+};
+
+// The curves of one channel, or its fallback when the channel has no curve node.
+struct ChannelCursor {
+    bool animated = false;
+    bool constant = true;
+    Vec3 fallback;
+    CurveCursor curves[3];
+};
+
+static void initCurveCursor(CurveCursor *cursor, const AnimationCurve *curve, float fallback) {
+    cursor->value = fallback;
+    if (!curve || curve->getKeyCount() == 0) return;
+    cursor->times = curve->getKeyTime();
+    cursor->values = curve->getKeyValue();
+    cursor->count = curve->getKeyCount();
+    cursor->value = cursor->values[0];
+    for (int c = 1; c < cursor->count; c++) {
+        if (cursor->values[c] != cursor->values[0]) cursor->constant = false;
+    }
+}
+
+static float evalCurveCursor(CurveCursor *cursor, ofbx::u64 time) {
+    if (cursor->constant) return cursor->value;
+    const ofbx::u64 *times = cursor->times;
+    const float *values = cursor->values;
+    int count = cursor->count;
+    if (time < times[0]) time = times[0];
+    if (time > times[count - 1]) time = times[count - 1];
+    while (cursor->key < count - 1 && times[cursor->key] < time) cursor->key++;
+    int i = cursor->key;
+    // keys on the sample grid are copied as they are
+    if (times[i] == time) return values[i];
+    if (times[i - 1] == time) return values[i - 1];
+    float t = float(double(time - times[i - 1]) / double(times[i] - times[i - 1]));
+    return values[i - 1] * (1 - t) + values[i] * t;
+}
+
+static void initChannelCursor(ChannelCursor *channel, const AnimationCurveNode *curveNode, Vec3 fallback) {
+    channel->fallback = fallback;
+    if (!curveNode) return;
+    channel->animated = true;
+    for (int c = 0; c < 3; c++) {
+        initCurveCursor(&channel->curves[c], curveNode->getCurve(c), float(fallback.xyz[c]));
+        if (!channel->curves[c].constant) channel->constant = false;
+    }
+}
+
+// Starts the cursors of a channel from the first key again.
+static void rewindChannelCursor(ChannelCursor *channel) {
+    for (CurveCursor &curve : channel->curves) curve.key = 1;
+}
+
+static Vec3 evalChannelCursor(ChannelCursor *channel, ofbx::u64 time) {
+    if (!channel->animated) return channel->fallback;
+    Vec3 out;
+    for (int c = 0; c < 3; c++) out.xyz[c] = evalCurveCursor(&channel->curves[c], time);
+    return out;
+}
+
+
+// ---------------------- Sampling ------------------------
+
 struct AnimatedNode {
     Node *modelNode;
     const AnimationCurveNode *translation;
     const AnimationCurveNode *rotation;
     const AnimationCurveNode *scale;
+    LocalTransformEvaluator local;
+    ChannelCursor tcurves;
+    ChannelCursor rcurves;
+    ChannelCursor scurves;
+    bool constant = false; // every curve of the node is constant, so one sample covers all frames
     s32 toff = -1;
     s32 roff = -1;
     s32 soff = -1;
-    std::vector<float> data;
-    s32 width;
-    float *tdata = nullptr;
-    float *rdata = nullptr;
-    float *sdata = nullptr;
     bool needsT = false;
     bool needsR = false;
     bool needsS = false;
+    std::vector<AnimationTrack> tracks; // with opts->sourceKeys
 };
 
+// One animation stack, set up serially, then sampled in parallel and packed serially again.
+struct AnimationSampling {
+    Animation anim;
+    double startTime;
+    double timespan;
+    int numKeyframes;
+    std::vector<AnimatedNode> animatedNodes;
+};
+
+// Frames sampled at a time, the matrix math for a block is done with the batch functions.
+static const int sampleBlockSize = 64;
+
+// LocalTransformEvaluator::eval for a block of frames. The products happen in the same order, so the results match.
+static void evalLocalBlock(const LocalTransformEvaluator &local, const Vec3 *ts, const Vec3 *rs, const Vec3 *ss, int count,
+                           std::vector<Matrix> &result, std::vector<Matrix> &factors) {
+    for (int c = 0; c < count; c++) {
+        result[c] = makeIdentity();
+        result[c].m[12] = ts[c].x;
+        result[c].m[13] = ts[c].y;
+        result[c].m[14] = ts[c].z;
+    }
+    for (int c = 0; c < local.pre_count; c++) mulMatrices(result.data(), 1, &local.pre[c], 0, result.data(), count);
+    for (int c = 0; c < count; c++) factors[c] = local.evalRotation(rs[c]);
+    mulMatrices(result.data(), 1, factors.data(), 1, result.data(), count);
+    for (int c = 0; c < local.post_count; c++) mulMatrices(result.data(), 1, &local.post[c], 0, result.data(), count);
+    for (int c = 0; c < count; c++) {
+        factors[c] = makeIdentity();
+        factors[c].m[0] = ss[c].x;
+        factors[c].m[5] = ss[c].y;
+        factors[c].m[10] = ss[c].z;
+    }
+    mulMatrices(result.data(), 1, factors.data(), 1, result.data(), count);
+    for (int c = 0; c < local.tail_count; c++) mulMatrices(result.data(), 1, &local.tail[c], 0, result.data(), count);
+}
+
+static void rewindAnimatedNode(AnimatedNode &an) {
+    rewindChannelCursor(&an.tcurves);
+    rewindChannelCursor(&an.rcurves);
+    rewindChannelCursor(&an.scurves);
+}
+
+// Evaluates the local t/r/s of a node at up to sampleBlockSize increasing times, continuing from the previous call.
+// Call rewindAnimatedNode before starting over from earlier times.
+static void evalAnimatedBlock(AnimatedNode &an, const ofbx::u64 *times, int count, float *td, float *rd, float *sd,
+                              std::vector<Matrix> &transforms, std::vector<Matrix> &factors) {
+    Vec3 ts[sampleBlockSize], rs[sampleBlockSize], ss[sampleBlockSize];
+    for (int c = 0; c < count; c++) {
+        ts[c] = evalChannelCursor(&an.tcurves, times[c]);
+        rs[c] = evalChannelCursor(&an.rcurves, times[c]);
+        ss[c] = evalChannelCursor(&an.scurves, times[c]);
+    }
+
+    // Convert to the object's local coordinate frame
+    evalLocalBlock(an.local, ts, rs, ss, count, transforms, factors);
+    extractTransforms(transforms.data(), count, td, rd, sd);
+}
+
+// Figures out which channels of a node are necessary before anything is written. A channel is necessary once one of
+// its samples differs from the bind pose, so the scan stops as soon as every channel is known to be or can't be.
+static void scanAnimatedNode(AnimatedNode &an, const AnimationSampling &sampling, Options *opts) {
+    rewindAnimatedNode(an);
+    int numKeyframes = sampling.numKeyframes;
+    ofbx::u64 times[sampleBlockSize];
+    float td[3 * sampleBlockSize], rd[4 * sampleBlockSize], sd[3 * sampleBlockSize];
+    std::vector<Matrix> transforms(sampleBlockSize), factors(sampleBlockSize);
+
+    // Get bind pose t/r/s for reference
+    float *tn = an.modelNode->translation;
+    float *rn = an.modelNode->rotation;
+    float *sn = an.modelNode->scale;
+
+    bool scanT = an.translation != nullptr;
+    bool scanR = an.rotation != nullptr;
+    bool scanS = an.scale != nullptr;
+    for (int first = 0; first < numKeyframes; first += sampleBlockSize) {
+        int count = std::min(sampleBlockSize, numKeyframes - first);
+        if (an.constant) count = 1;
+        for (int c = 0; c < count; c++) {
+            double frameTime = sampling.startTime + ((first + c) * sampling.timespan) / (numKeyframes - 1);
+            times[c] = ofbx::u64(frameTime * fbxTicksPerSecond);
+        }
+        evalAnimatedBlock(an, times, count, td, rd, sd, transforms, factors);
+
+        for (int c = 0; c < count; c++) {
+            if (scanT && !an.needsT && !close(tn, &td[3 * c], 3, opts->animError)) an.needsT = true;
+            if (scanR && !an.needsR && !close(rn, &rd[4 * c], 4, opts->animError)) an.needsR = true;
+            if (scanS && !an.needsS && !close(sn, &sd[3 * c], 3, opts->animError)) an.needsS = true;
+        }
+        if (an.constant) break;
+
+        if (first == 0) {
+            // Rotation and scale only depend on the linear part of the local transform, which translation doesn't
+            // change, so with constant rotation and scale curves the first sample decides them for every frame.
+            if (an.rcurves.constant && an.scurves.constant) {
+                scanR = scanS = false;
+            } else if (an.scurves.constant && scanS && !an.needsS) {
+                // With only constant scale curves, the scale of every frame is the same up to a float rounding,
+                // which only matters right at the threshold.
+                bool below = true;
+                for (int c = 0; c < 3; c++) {
+                    if (fabsf(sd[c] - sn[c]) + 2 * fabsf(sd[c]) * FLT_EPSILON >= opts->animError) below = false;
+                }
+                if (below) scanS = false;
+            }
+        }
+        bool decided = (!scanT || an.needsT) && (!scanR || an.needsR) && (!scanS || an.needsS);
+        if (decided) break;
+    }
+}
+
+// Samples every keyframe of one node straight into the necessary channels of the animation's nodeData. Each node only
+// writes its own columns, so nodes of the same animation can be sampled in parallel.
+static void sampleAnimatedNode(AnimatedNode &an, AnimationSampling &sampling) {
+    if (!(an.needsT | an.needsR | an.needsS)) return;
+    rewindAnimatedNode(an);
+    int numKeyframes = sampling.numKeyframes;
+    int stride = int(sampling.anim.stride);
+    float *nodeData = sampling.anim.nodeData.data();
+    ofbx::u64 times[sampleBlockSize];
+    float td[3 * sampleBlockSize], rd[4 * sampleBlockSize], sd[3 * sampleBlockSize];
+    std::vector<Matrix> transforms(sampleBlockSize), factors(sampleBlockSize);
+
+    for (int first = 0; first < numKeyframes; first += sampleBlockSize) {
+        int count = std::min(sampleBlockSize, numKeyframes - first);
+        if (an.constant) count = 1;
+        for (int c = 0; c < count; c++) {
+            double frameTime = sampling.startTime + ((first + c) * sampling.timespan) / (numKeyframes - 1);
+            times[c] = ofbx::u64(frameTime * fbxTicksPerSecond);
+        }
+        evalAnimatedBlock(an, times, count, td, rd, sd, transforms, factors);
+
+        // a constant node's only sample goes to every frame
+        int nFrames = an.constant ? numKeyframes : count;
+        for (int c = 0; c < nFrames; c++) {
+            float *frame = &nodeData[(first + c) * stride];
+            int sample = an.constant ? 0 : c;
+            if (an.needsT) memcpy(&frame[an.toff], &td[3 * sample], 3 * sizeof(float));
+            if (an.needsR) memcpy(&frame[an.roff], &rd[4 * sample], 4 * sizeof(float));
+            if (an.needsS) memcpy(&frame[an.soff], &sd[3 * sample], 3 * sizeof(float));
+        }
+        if (an.constant) break;
+    }
+}
+
+// With opts->sourceKeys, keys the node at the key times of its curves instead of sampling it. The times of every curve
+// of the node are merged, since pivots and offsets let each input channel affect every output channel.
+static void keyAnimatedNode(AnimatedNode &an, const AnimationSampling &sampling, Options *opts) {
+    rewindAnimatedNode(an);
+    ofbx::u64 start = ofbx::u64(sampling.startTime * fbxTicksPerSecond);
+    ofbx::u64 end = ofbx::u64((sampling.startTime + sampling.timespan) * fbxTicksPerSecond);
+    std::vector<ofbx::u64> times;
+    times.push_back(start);
+    if (!an.constant) {
+        for (const ChannelCursor *channel : {&an.tcurves, &an.rcurves, &an.scurves}) {
+            for (const CurveCursor &curve : channel->curves) {
+                if (curve.constant) continue;
+                for (int c = 0; c < curve.count; c++) {
+                    if (curve.times[c] > start && curve.times[c] < end) times.push_back(curve.times[c]);
+                }
+            }
+        }
+        if (end > start) times.push_back(end);
+        std::sort(times.begin(), times.end());
+        times.erase(std::unique(times.begin(), times.end()), times.end());
+    }
+
+    int nKeys = int(times.size());
+    std::vector<float> td(3 * nKeys), rd(4 * nKeys), sd(3 * nKeys);
+    std::vector<Matrix> transforms(sampleBlockSize), factors(sampleBlockSize);
+    for (int first = 0; first < nKeys; first += sampleBlockSize) {
+        int count = std::min(sampleBlockSize, nKeys - first);
+        evalAnimatedBlock(an, &times[first], count, &td[3 * first], &rd[4 * first], &sd[3 * first], transforms, factors);
+    }
+
+    // Key times are scaled to the duration the animation is written with, like the frames of sampled animations.
+    double duration = sampling.anim.samplingRate * (sampling.numKeyframes - 1);
+    double timeScale = sampling.timespan > 0 ? duration / sampling.timespan : 0;
+    float *bindPose[3] = {an.modelNode->translation, an.modelNode->rotation, an.modelNode->scale};
+    float *values[3] = {td.data(), rd.data(), sd.data()};
+    bool animated[3] = {an.translation != nullptr, an.rotation != nullptr, an.scale != nullptr};
+    bool *needs[3] = {&an.needsT, &an.needsR, &an.needsS};
+    for (u32 channel = CHANNEL_TRANSLATION; channel <= CHANNEL_SCALE; channel++) {
+        if (!animated[channel]) continue;
+        int width = channel == CHANNEL_ROTATION ? 4 : 3;
+        for (int k = 0; k < nKeys && !*needs[channel]; k++) {
+            if (!close(bindPose[channel], &values[channel][k * width], width, opts->animError)) {
+                *needs[channel] = true;
+            }
+        }
+        if (!*needs[channel]) continue;
+
+        an.tracks.emplace_back();
+        AnimationTrack &track = an.tracks.back();
+        track.channel = channel;
+        track.times.resize(nKeys);
+        track.values.assign(values[channel], values[channel] + nKeys * width);
+        for (int k = 0; k < nKeys; k++) {
+            track.times[k] = float(double(times[k] - start) / fbxTicksPerSecond * timeScale);
+            if (channel == CHANNEL_ROTATION && k > 0) {
+                float *prev = &track.values[(k - 1) * 4];
+                float *cur = &track.values[k * 4];
+                if (prev[0]*cur[0] + prev[1]*cur[1] + prev[2]*cur[2] + prev[3]*cur[3] < 0) {
+                    for (int c = 0; c < 4; c++) cur[c] = -cur[c];
+                }
+            }
+        }
+    }
+}
+
+// Moves the tracks of keyed nodes into the animation, stripping untransformed nodes.
+static void packKeyedAnimation(AnimationSampling &sampling) {
+    Animation *anim = &sampling.anim;
+    anim->stride = 0;
+    size_t nKeys = 0;
+    for (AnimatedNode &an : sampling.animatedNodes) {
+        if (an.tracks.empty()) continue;
+        u32 node = u32(anim->nodeIDs.size());
+        anim->nodeIDs.push_back(an.modelNode->id);
+        for (AnimationTrack &track : an.tracks) {
+            track.node = node;
+            nKeys += track.times.size();
+            anim->tracks.push_back(std::move(track));
+        }
+        std::vector<AnimationTrack>().swap(an.tracks);
+    }
+    printf("Animation %s: %d tracks with %d source keys\n", anim->id.c_str(), int(anim->tracks.size()), int(nKeys));
+}
+
+// Assigns offsets to the necessary channels for the packed format, stripping untransformed nodes, and allocates the
+// nodeData they are sampled into.
+static void layoutAnimation(AnimationSampling &sampling) {
+    Animation *anim = &sampling.anim;
+    int offset = 0;
+    for (AnimatedNode &an : sampling.animatedNodes) {
+        if (an.needsT | an.needsR | an.needsS) {
+            anim->nodeIDs.push_back(an.modelNode->id);
+            if (an.needsT) {
+                an.toff = offset;
+                offset += 3;
+            }
+            if (an.needsR) {
+                an.roff = offset;
+                offset += 4;
+            }
+            if (an.needsS) {
+                an.soff = offset;
+                offset += 3;
+            }
+            anim->nodeFormats.push_back(an.toff);
+            anim->nodeFormats.push_back(an.roff);
+            anim->nodeFormats.push_back(an.soff);
+        }
+    }
+    anim->stride = offset;
+    anim->nodeData.resize(size_t(offset) * sampling.numKeyframes);
+}
+
 static void convertAnimations(const IScene *scene, Model *model, Options *opts) {
     std::vector<Node *> nodes;
     collectNodesRecursive(model->nodes, nodes);
 
     int nAnimation = scene->getAnimationStackCount();
     if (nAnimation > 0) {
-        printf("Sampling animations every %f seconds (%f FPS)\n", opts->animSamplingRate, 1.0/opts->animSamplingRate);
+        if (opts->sourceKeys) printf("Keying animations at their source key times\n");
+        else printf("Sampling animations every %f seconds (%f FPS)\n", opts->animSamplingRate, 1.0/opts->animSamplingRate);
     }
 
+    std::vector<AnimationSampling> stacks;
+    stacks.reserve(nAnimation);
     for (int c = 0; c < nAnimation; c++) {
         const AnimationStack *stack = scene->getAnimationStack(c);
         const TakeInfo *take = scene->getTakeInfo(stack->name);
@@ -939,19 +1515,25 @@ static void convertAnimations(const IScene *scene, Model *model, Options *opts)
             printf("Warning: Ignoring animation with no keyframes: %s\n", stack->name);
             continue;
         }
-        printf("Take %s for (%f, %f), sampling %d keyframes.\n", stack->name, take->local_time_from, take->local_time_to, numKeyframes);
-
-        std::vector<AnimatedNode> animatedNodes;
+        if (opts->sourceKeys) printf("Take %s for (%f, %f).\n", stack->name, take->local_time_from, take->local_time_to);
+        else printf("Take %s for (%f, %f), sampling %d keyframes.\n", stack->name, take->local_time_from, take->local_time_to, numKeyframes);
+
+        stacks.emplace_back();
+        AnimationSampling &sampling = stacks.back();
+        sampling.startTime = startTime;
+        sampling.timespan = timespan;
+        sampling.numKeyframes = numKeyframes;
+        std::vector<AnimatedNode> &animatedNodes = sampling.animatedNodes;
         animatedNodes.reserve(nodes.size());
 
-        model->animations.emplace_back();
-        Animation *anim = &model->animations.back();
+        Animation *anim = &sampling.anim;
         anim->id = &stack->name[0];
         anim->frames = numKeyframes;
         anim->samplingRate = opts->animSamplingRate;
 
-        // First set up a buffer for each node that's animated
+        // Set up each node that's animated
         const AnimationLayer *layer = stack->getLayer(0);
+        int nConstant = 0;
         for (Node *node : nodes) {
             const AnimationCurveNode *translation = layer->getCurveNode(*node->source, "Lcl Translation");
             const AnimationCurveNode *rotation = layer->getCurveNode(*node->source, "Lcl Rotation");
@@ -963,137 +1545,89 @@ static void convertAnimations(const IScene *scene, Model *model, Options *opts)
                 an.translation = translation;
                 an.rotation = rotation;
                 an.scale = scale;
-                u32 size = 0;
-                if (translation) size += 3;
-                if (rotation) size += 4;
-                if (scale) size += 3;
-                an.width = size;
-                an.data.resize(size * numKeyframes);
-                float *data = an.data.data();
-                if (translation) {
-                    an.tdata = data;
-                    data += 3;
-                }
-                if (rotation) {
-                    an.rdata = data;
-                    data += 4;
-                }
-                if (scale) {
-                    an.sdata = data;
-                }
+                an.local = node->source->compileLocal();
+                initChannelCursor(&an.tcurves, translation, an.local.translation);
+                initChannelCursor(&an.rcurves, rotation, an.local.rotation);
+                initChannelCursor(&an.scurves, scale, an.local.scaling);
+                an.constant = an.tcurves.constant && an.rcurves.constant && an.scurves.constant;
+                if (an.constant) nConstant++;
             }
         }
         if (animatedNodes.size() == 0) {
             printf("Warning: Ignoring animation with no keyframes: %s\n", anim->id.c_str());
-            model->animations.pop_back();
+            stacks.pop_back();
             continue;
         }
+        if (nConstant > 0) {
+            printf("  %d of %d animated nodes have constant curves and are sampled once\n", nConstant, int(animatedNodes.size()));
+        }
+    }
 
-        // Second, calculate all of the transforms for each keyframe and figure out which channels are necessary
-        for (int frame = 0; frame < numKeyframes; frame++) {
-            double frameTime = startTime + (frame * timespan) / (numKeyframes - 1);
-            for (AnimatedNode &an : animatedNodes) {
-                // Get animated t/r/s
-                Vec3 ts = an.modelNode->source->getLocalTranslation();
-                Vec3 rs = an.modelNode->source->getLocalRotation();
-                Vec3 ss = an.modelNode->source->getLocalScaling();
-                if (an.translation) ts = an.translation->getNodeLocalTransform(frameTime, ts);
-                if (an.rotation) rs = an.rotation->getNodeLocalTransform(frameTime, rs);
-                if (an.scale) ss = an.scale->getNodeLocalTransform(frameTime, ss);
-
-                // Convert to the object's local coordinate frame
-                Matrix animTransform = an.modelNode->source->evalLocal(ts, rs, ss);
-                float td[3], rd[4], sd[3];
-                extractTransform(&animTransform, td, rd, sd);
-
-                // Get bind pose t/r/s for reference
-                float *tn = an.modelNode->translation;
-                float *rn = an.modelNode->rotation;
-                float *sn = an.modelNode->scale;
-
-                // Record channel data and check for necessity
-                if (an.translation) {
-                    float *tr = &an.tdata[an.width * frame];
-                    memcpy(tr, td, sizeof(td));
-                    if (!close(tn, td, 3, opts->animError)) {
-                        an.needsT = true;
-                    }
-                }
-                if (an.rotation) {
-                    float *rr = &an.rdata[an.width * frame];
-                    memcpy(rr, rd, sizeof(rd));
-                    if (!close(rn, rd, 4, opts->animError)) {
-                        an.needsR = true;
-                    }
-                }
-                if (an.scale) {
-                    float *sr = &an.sdata[an.width * frame];
-                    memcpy(sr, sd, sizeof(sd));
-                    if (!close(sn, sd, 3, opts->animError)) {
-                        an.needsS = true;
-                    }
-                }
-            }
+    // Every animated node of every stack is handled in parallel. Nodes only read the scene and write their own data.
+    std::vector<std::pair<AnimationSampling *, AnimatedNode *>> work;
+    for (AnimationSampling &sampling : stacks) {
+        for (AnimatedNode &an : sampling.animatedNodes) {
+            work.emplace_back(&sampling, &an);
         }
+    }
+    if (opts->sourceKeys) {
+        parallelFor(int(work.size()), opts->threads, [&](int c) {
+            keyAnimatedNode(*work[c].second, *work[c].first, opts);
+        });
+    } else {
+        // Decide which channels are necessary first, so the samples can go straight into the final layout.
+        parallelFor(int(work.size()), opts->threads, [&](int c) {
+            scanAnimatedNode(*work[c].second, *work[c].first, opts);
+        });
+        for (AnimationSampling &sampling : stacks) {
+            layoutAnimation(sampling);
+        }
+        parallelFor(int(work.size()), opts->threads, [&](int c) {
+            sampleAnimatedNode(*work[c].second, *work[c].first);
+        });
+    }
 
-        // Next up, assign offsets to all of the channels for the packed format and strip untransformed nodes.
-        int offset = 0;
-        for (AnimatedNode &an : animatedNodes) {
-            if (an.needsT | an.needsR | an.needsS) {
-                anim->nodeIDs.push_back(an.modelNode->id);
-                if (an.needsT) {
-                    an.toff = offset;
-                    offset += 3;
-                }
-                if (an.needsR) {
-                    an.roff = offset;
-                    offset += 4;
-                }
-                if (an.needsS) {
-                    an.soff = offset;
-                    offset += 3;
-                }
-                anim->nodeFormats.push_back(an.toff);
-                anim->nodeFormats.push_back(an.roff);
-                anim->nodeFormats.push_back(an.soff);
+    // Packing is serial and in stack order, so the output doesn't depend on the thread count.
+    for (AnimationSampling &sampling : stacks) {
+        if (opts->sourceKeys) packKeyedAnimation(sampling);
+        model->animations.push_back(std::move(sampling.anim));
+    }
+}
+
+// Moves the node parts of rigidly skinned geometry under the nodes of their bones.
+static void attachRigidParts(Model *model) {
+    std::vector<Node *> nodes;
+    collectNodesRecursive(model->nodes, nodes);
+    for (Node *node : nodes) {
+        for (size_t c = 0; c < node->parts.size();) {
+            NodePart &part = node->parts[c];
+            if (!part.attachTo) {
+                c++;
+                continue;
             }
-        }
-        anim->stride = offset;
-
-        int frameSize = offset;
-        u32 totalSize = frameSize * numKeyframes;
-        anim->nodeData.resize(totalSize);
-        float *nodeData = anim->nodeData.data();
-        for (AnimatedNode &an : animatedNodes) {
-            if (an.needsT | an.needsR | an.needsS) {
-                float *frame = nodeData;
-                float *t = an.tdata;
-                float *r = an.rdata;
-                float *s = an.sdata;
-                int w = an.width;
-                for (int c = 0; c < numKeyframes; c++) {
-                    if (an.needsT) {
-                        memcpy(&frame[an.toff], t, 3*sizeof(float));
-                        t += w;
-                    }
-                    if (an.needsR) {
-                        memcpy(&frame[an.roff], r, 4*sizeof(float));
-                        r += w;
-                    }
-                    if (an.needsS) {
-                        memcpy(&frame[an.soff], s, 3*sizeof(float));
-                        s += w;
-                    }
-                    frame += frameSize;
-                }
+            Node *bone = nullptr;
+            for (Node *candidate : nodes) {
+                if (candidate->source == part.attachTo) bone = candidate;
+            }
+            if (!bone) {
+                printf("Warning: bone for rigid part %s isn't in the node tree, leaving it on %s\n", part.meshPartID.c_str(), node->id.c_str());
+                part.attachTo = nullptr;
+                c++;
+                continue;
             }
+            printf("Attached rigid part %s to bone %s\n", part.meshPartID.c_str(), bone->id.c_str());
+            part.attachTo = nullptr;
+            bone->parts.push_back(std::move(part));
+            node->parts.erase(node->parts.begin() + c);
         }
     }
 }
 
 bool convertFbxToModel(const IScene *scene, Model *model, Options *opts) {
     const Object *root = scene->getRoot();
-    convertChildrenRecursive(scene, root, model, &model->nodes, opts);
+    std::vector<MeshInstance> instances;
+    convertChildrenRecursive(scene, root, model, &model->nodes, &instances, opts);
+    if (opts->rigidParts) attachRigidParts(model);
 
     convertAnimations(scene, model, opts);
 
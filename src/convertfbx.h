@@ -9,6 +9,9 @@
 #include "model.h"
 #include "args.h"
 
+// Returns the index of an equal vertex already in the mesh, or appends this one.
+u32 addVertex(ModelMesh *mesh, float *vertex);
+
 bool convertFbxToModel(const ofbx::IScene *scene, Model *model, Options *opts);
 
 #endif //PB_FBX_CONV_LOADFBX_H
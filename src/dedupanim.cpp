@@ -0,0 +1,142 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "dedupanim.h"
+#include "reduceanim.h"
+
+template<typename T>
+static bool sameData(const std::vector<T> &a, const std::vector<T> &b) {
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+template<typename T>
+static u64 hashData(u64 h, const std::vector<T> &data) {
+    const u8 *bytes = (const u8 *) data.data();
+    for (size_t c = 0, n = data.size() * sizeof(T); c < n; c++) {
+        h = (h ^ bytes[c]) * 1099511628211ull; // FNV-1a
+    }
+    return h;
+}
+
+// Everything about a track except the node it animates.
+static bool sameTrack(const AnimationTrack &a, const AnimationTrack &b) {
+    if (a.channel != b.channel || a.compressed != b.compressed) return false;
+    if (!sameData(a.times, b.times)) return false;
+    if (!a.compressed) return sameData(a.values, b.values);
+    return a.bits == b.bits && memcmp(a.min, b.min, sizeof(a.min)) == 0 &&
+           memcmp(a.extent, b.extent, sizeof(a.extent)) == 0 && sameData(a.packed, b.packed);
+}
+
+static u64 hashTrack(const AnimationTrack &track) {
+    u64 h = 14695981039346656037ull + track.channel;
+    h = hashData(h, track.times);
+    return track.compressed ? hashData(h, track.packed) : hashData(h, track.values);
+}
+
+static bool sameAnimation(const Animation &a, const Animation &b) {
+    if (a.frames != b.frames || a.samplingRate != b.samplingRate || a.nodeIDs != b.nodeIDs) return false;
+    if (a.tracks.size() != b.tracks.size()) return false;
+    if (a.tracks.empty()) {
+        return a.stride == b.stride && a.nodeFormats == b.nodeFormats && sameData(a.nodeData, b.nodeData);
+    }
+    for (size_t c = 0; c < a.tracks.size(); c++) {
+        if (a.tracks[c].node != b.tracks[c].node || !sameTrack(a.tracks[c], b.tracks[c])) return false;
+    }
+    return true;
+}
+
+void dedupAnimations(Model *model, Options *opts) {
+    if (!opts->dedupAnimations) return;
+    if (!opts->p3db) {
+        printf("Warning: shared animation data is only written with p3db animations (-a), ignoring -D\n");
+        return;
+    }
+
+    int nAliases = 0;
+    for (size_t c = 1; c < model->animations.size(); c++) {
+        Animation &anim = model->animations[c];
+        for (size_t d = 0; d < c; d++) {
+            const Animation &original = model->animations[d];
+            if (!original.alias.empty() || !sameAnimation(anim, original)) continue;
+            printf("Animation %s is identical to %s\n", anim.id.c_str(), original.id.c_str());
+            anim.alias = original.id;
+            std::vector<f32>().swap(anim.nodeData);
+            std::vector<AnimationTrack>().swap(anim.tracks);
+            nAliases++;
+            break;
+        }
+    }
+
+    // Sampled animations are matched as tracks, but only become tracks if they share one (either way).
+    size_t nAnims = model->animations.size();
+    std::vector<std::vector<AnimationTrack>> built(nAnims);
+    std::vector<bool> sharing(nAnims, false);
+    auto trackAt = [&](s32 a, s32 t) -> AnimationTrack & {
+        return built[a].empty() ? model->animations[a].tracks[t] : built[a][t];
+    };
+
+    // hash -> (animation, track) of the tracks that are written out
+    std::unordered_map<u64, std::vector<std::pair<s32, s32>>> written;
+    int nShared = 0;
+    size_t savedBytes = 0;
+    for (s32 a = 0; a < s32(nAnims); a++) {
+        Animation &anim = model->animations[a];
+        if (!anim.alias.empty()) continue;
+        if (anim.tracks.empty()) {
+            Animation sampled;
+            sampled.frames = anim.frames;
+            sampled.samplingRate = anim.samplingRate;
+            sampled.stride = anim.stride;
+            sampled.nodeIDs = anim.nodeIDs;
+            sampled.nodeFormats = anim.nodeFormats;
+            sampled.nodeData = anim.nodeData;
+            buildTracks(&sampled);
+            built[a].swap(sampled.tracks);
+        }
+        for (s32 t = 0, nTracks = s32(built[a].empty() ? anim.tracks.size() : built[a].size()); t < nTracks; t++) {
+            AnimationTrack &track = trackAt(a, t);
+            std::vector<std::pair<s32, s32>> &candidates = written[hashTrack(track)];
+            for (const std::pair<s32, s32> &candidate : candidates) {
+                if (!sameTrack(track, trackAt(candidate.first, candidate.second))) continue;
+                track.refAnimation = candidate.first;
+                track.refTrack = candidate.second;
+                sharing[a] = sharing[candidate.first] = true;
+                break;
+            }
+            if (track.refAnimation < 0) {
+                candidates.emplace_back(a, t);
+                continue;
+            }
+            savedBytes += track.times.size() * sizeof(f32);
+            savedBytes += track.compressed ? track.packed.size() : track.values.size() * sizeof(f32);
+            std::vector<f32>().swap(track.times);
+            std::vector<f32>().swap(track.values);
+            std::vector<u8>().swap(track.packed);
+            nShared++;
+        }
+    }
+
+    // Tracks of sampled animations key every frame, so they leave out their times.
+    int nTracks = 0, nSampled = 0;
+    for (size_t a = 0; a < nAnims; a++) {
+        Animation &anim = model->animations[a];
+        if (!built[a].empty() && sharing[a]) {
+            anim.tracks.swap(built[a]);
+            std::vector<f32>().swap(anim.nodeData);
+            for (AnimationTrack &track : anim.tracks) std::vector<f32>().swap(track.times);
+        } else if (!built[a].empty()) {
+            nSampled++;
+        }
+        std::vector<AnimationTrack>().swap(built[a]);
+        nTracks += int(anim.tracks.size());
+    }
+    printf("Deduplication: %d animations are aliases, %d of %d tracks are shared, saving %d bytes",
+           nAliases, nShared, nTracks, int(savedBytes));
+    if (nSampled) printf(", %d sampled animations share nothing and stay sampled", nSampled);
+    printf("\n");
+}
@@ -0,0 +1,16 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_DEDUPANIM_H
+#define PB_FBX_CONV_DEDUPANIM_H
+
+#include "model.h"
+#include "args.h"
+
+// With opts->dedupAnimations and p3db output, turns every animation that is identical to an earlier one into an alias
+// of it, and converts the rest to tracks. Each track that is identical to an earlier track, of the same or an earlier
+// animation, becomes a reference to it. See Animation::alias and AnimationTrack::refAnimation.
+void dedupAnimations(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_DEDUPANIM_H
@@ -14,6 +14,17 @@
 #include "args.h"
 #include "convertobj.h"
 #include "writep3db.h"
+#include "vertexstreams.h"
+#include "optimizemesh.h"
+#include "simplifymesh.h"
+#include "quantizemesh.h"
+#include "batchmesh.h"
+#include "reduceanim.h"
+#include "compressanim.h"
+#include "stripanim.h"
+#include "planaranim.h"
+#include "dedupanim.h"
+#include "additiveanim.h"
 
 Options opts;
 
@@ -64,9 +75,24 @@ int main(int argc, char *argv[]) {
         convertFbxToObj(scene, "geom.obj");
     }
 
+    if (opts.benchStreams) {
+        benchmarkVertexStreams(scene);
+    }
+
     // convert to a Model
     Model model;
     convertFbxToModel(scene, &model, &opts);
+    stripUnusedAnimation(&model, &opts);
+    makeAnimationsAdditive(&model, &opts);
+    batchStaticMeshes(&model, &opts);
+    generateLods(&model, &opts);
+    optimizeMeshes(&model, &opts);
+    quantizeMeshes(&model, &opts);
+    chooseIndexWidths(&model, &opts);
+    reduceKeyframes(&model, &opts);
+    compressAnimations(&model, &opts);
+    dedupAnimations(&model, &opts);
+    planarizeAnimations(&model, &opts);
 
     // export model to json
     if (opts.useJson) writeP3dj(&model, opts.outpath, opts.p3db);
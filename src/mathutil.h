@@ -8,13 +8,21 @@
 #include <cmath>
 #include "ofbx.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MATHUTIL_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATHUTIL_SSE2 1
+#endif
+
 static ofbx::Vec3 mul(const ofbx::Matrix *mat, ofbx::Vec3 vec) {
     ofbx::Vec3 out = {0};
     for (int c = 0; c < 3; c++) {
         double component = vec.xyz[c];
-        out.x += mat->m[c+0] * component;
-        out.y += mat->m[c+4] * component;
-        out.z += mat->m[c+8] * component;
+        out.x += mat->m[4*c+0] * component;
+        out.y += mat->m[4*c+1] * component;
+        out.z += mat->m[4*c+2] * component;
     }
     out.x += mat->m[12];
     out.y += mat->m[13];
@@ -104,13 +112,10 @@ static void extractTransform(const ofbx::Matrix *mat, float *translation, float
     rotation[3] = (float) (qw * qn);
 }
 
-static bool invertMatrix(const ofbx::Matrix *mat, ofbx::Matrix *out)
+// The cofactors of m, shared by invertMatrix and the batch version below so both round identically.
+template<typename D>
+static void invertCofactors(const D *m, D *inv)
 {
-    double inv[16], det;
-    int i;
-
-    const double (&m)[16] = mat->m;
-
     inv[0] = m[5]  * m[10] * m[15] -
              m[5]  * m[11] * m[14] -
              m[9]  * m[6]  * m[15] +
@@ -222,6 +227,16 @@ static bool invertMatrix(const ofbx::Matrix *mat, ofbx::Matrix *out)
               m[4] * m[2] * m[9] +
               m[8] * m[1] * m[6] -
               m[8] * m[2] * m[5];
+}
+
+static bool invertMatrix(const ofbx::Matrix *mat, ofbx::Matrix *out)
+{
+    double inv[16], det;
+    int i;
+
+    const double (&m)[16] = mat->m;
+
+    invertCofactors(m, inv);
 
     det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
 
@@ -329,4 +344,241 @@ static void eulerToQuaternion(const ofbx::Vec3 &euler, float *quat) {
     extractTransform(&rotation, translation, quat, scale);
 }
 
+
+// ---------------------- Batches ------------------------
+// Versions of mul, invertMatrix and extractTransform for whole arrays, for example every frame
+// of a track. With SSE2 or AVX available at compile time they work on 2 or 4 doubles at once, otherwise they loop
+// over the functions above. Every operation happens in the same order as in the scalar version, and there are no
+// fused multiply-adds, so the results are bit-identical.
+
+#if MATHUTIL_AVX || MATHUTIL_SSE2
+
+// The same double from several consecutive matrices, one matrix per lane.
+struct DoubleLanes {
+#if MATHUTIL_AVX
+    __m256d v;
+    static const int count = 4;
+#else
+    __m128d v;
+    static const int count = 2;
+#endif
+};
+
+#if MATHUTIL_AVX
+static inline DoubleLanes lanes(double value) { return {_mm256_set1_pd(value)}; }
+static inline DoubleLanes operator+(DoubleLanes a, DoubleLanes b) { return {_mm256_add_pd(a.v, b.v)}; }
+static inline DoubleLanes operator-(DoubleLanes a, DoubleLanes b) { return {_mm256_sub_pd(a.v, b.v)}; }
+static inline DoubleLanes operator*(DoubleLanes a, DoubleLanes b) { return {_mm256_mul_pd(a.v, b.v)}; }
+static inline DoubleLanes operator/(DoubleLanes a, DoubleLanes b) { return {_mm256_div_pd(a.v, b.v)}; }
+static inline DoubleLanes operator-(DoubleLanes a) { return {_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))}; }
+static inline DoubleLanes laneSqrt(DoubleLanes a) { return {_mm256_sqrt_pd(a.v)}; }
+static inline DoubleLanes laneLess(DoubleLanes a, DoubleLanes b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+static inline DoubleLanes laneSelect(DoubleLanes mask, DoubleLanes a, DoubleLanes b) { return {_mm256_blendv_pd(b.v, a.v, mask.v)}; }
+// Column c of 4 consecutive matrices, transposed so that out[r] holds m[4*c+r] of each.
+static inline void loadColumnLanes(const ofbx::Matrix *mats, int c, DoubleLanes *out) {
+    __m256d r0 = _mm256_loadu_pd(&mats[0].m[4 * c]);
+    __m256d r1 = _mm256_loadu_pd(&mats[1].m[4 * c]);
+    __m256d r2 = _mm256_loadu_pd(&mats[2].m[4 * c]);
+    __m256d r3 = _mm256_loadu_pd(&mats[3].m[4 * c]);
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+    out[0].v = _mm256_permute2f128_pd(t0, t2, 0x20);
+    out[1].v = _mm256_permute2f128_pd(t1, t3, 0x20);
+    out[2].v = _mm256_permute2f128_pd(t0, t2, 0x31);
+    out[3].v = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+static inline void storeLanes(DoubleLanes a, double *out) { _mm256_storeu_pd(out, a.v); }
+static inline void storeLanes(DoubleLanes a, float *out) { _mm_storeu_ps(out, _mm256_cvtpd_ps(a.v)); }
+#else
+static inline DoubleLanes lanes(double value) { return {_mm_set1_pd(value)}; }
+static inline DoubleLanes operator+(DoubleLanes a, DoubleLanes b) { return {_mm_add_pd(a.v, b.v)}; }
+static inline DoubleLanes operator-(DoubleLanes a, DoubleLanes b) { return {_mm_sub_pd(a.v, b.v)}; }
+static inline DoubleLanes operator*(DoubleLanes a, DoubleLanes b) { return {_mm_mul_pd(a.v, b.v)}; }
+static inline DoubleLanes operator/(DoubleLanes a, DoubleLanes b) { return {_mm_div_pd(a.v, b.v)}; }
+static inline DoubleLanes operator-(DoubleLanes a) { return {_mm_xor_pd(a.v, _mm_set1_pd(-0.0))}; }
+static inline DoubleLanes laneSqrt(DoubleLanes a) { return {_mm_sqrt_pd(a.v)}; }
+static inline DoubleLanes laneLess(DoubleLanes a, DoubleLanes b) { return {_mm_cmplt_pd(a.v, b.v)}; }
+static inline DoubleLanes laneSelect(DoubleLanes mask, DoubleLanes a, DoubleLanes b) {
+    return {_mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v))};
+}
+// Column c of 2 consecutive matrices, transposed so that out[r] holds m[4*c+r] of each.
+static inline void loadColumnLanes(const ofbx::Matrix *mats, int c, DoubleLanes *out) {
+    __m128d a = _mm_loadu_pd(&mats[0].m[4 * c]);
+    __m128d b = _mm_loadu_pd(&mats[1].m[4 * c]);
+    out[0].v = _mm_unpacklo_pd(a, b);
+    out[1].v = _mm_unpackhi_pd(a, b);
+    a = _mm_loadu_pd(&mats[0].m[4 * c + 2]);
+    b = _mm_loadu_pd(&mats[1].m[4 * c + 2]);
+    out[2].v = _mm_unpacklo_pd(a, b);
+    out[3].v = _mm_unpackhi_pd(a, b);
+}
+static inline void storeLanes(DoubleLanes a, double *out) { _mm_storeu_pd(out, a.v); }
+static inline void storeLanes(DoubleLanes a, float *out) {
+    float tmp[4];
+    _mm_storeu_ps(tmp, _mm_cvtpd_ps(a.v));
+    out[0] = tmp[0];
+    out[1] = tmp[1];
+}
+#endif
+
+// extractTransform for DoubleLanes::count matrices. Outputs are written as [lane][component].
+static void extractTransformLanes(const ofbx::Matrix *mats, float *translation, float *rotation, float *scale) {
+    const int n = DoubleLanes::count;
+    DoubleLanes m[16];
+    for (int c = 0; c < 4; c++) loadColumnLanes(mats, c, &m[4 * c]);
+
+    DoubleLanes sx = laneSqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+    DoubleLanes sy = laneSqrt(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]);
+    DoubleLanes sz = laneSqrt(m[8] * m[8] + m[9] * m[9] + m[10] * m[10]);
+
+    DoubleLanes one = lanes(1.0);
+    DoubleLanes isx = one / sx;
+    DoubleLanes isy = one / sy;
+    DoubleLanes isz = one / sz;
+
+    DoubleLanes rxx = m[0] * isx;
+    DoubleLanes rxy = m[1] * isx;
+    DoubleLanes rxz = m[2] * isx;
+    DoubleLanes ryx = m[4] * isy;
+    DoubleLanes ryy = m[5] * isy;
+    DoubleLanes ryz = m[6] * isy;
+    DoubleLanes rzx = m[8] * isz;
+    DoubleLanes rzy = m[9] * isz;
+    DoubleLanes rzz = m[10] * isz;
+
+    // every form of extractTransform, then pick per lane with the same comparisons
+    DoubleLanes xt = one + rxx - ryy - rzz, xqy = rxy + ryx, xqz = rzx + rxz, xqw = ryz - rzy;
+    DoubleLanes yt = one - rxx + ryy - rzz, yqx = rxy + ryx, yqz = ryz + rzy, yqw = rzx - rxz;
+    DoubleLanes zt = one - rxx - ryy + rzz, zqx = rzx + rxz, zqy = ryz + rzy, zqw = rxy - ryx;
+    DoubleLanes wt = one + rxx + ryy + rzz, wqx = ryz - rzy, wqy = rzx - rxz, wqz = rxy - ryx;
+
+    DoubleLanes useXY = laneLess(rzz, lanes(0));
+    DoubleLanes useX = laneLess(ryy, rxx);
+    DoubleLanes useZ = laneLess(rxx, -ryy);
+    DoubleLanes t = laneSelect(useXY, laneSelect(useX, xt, yt), laneSelect(useZ, zt, wt));
+    DoubleLanes qx = laneSelect(useXY, laneSelect(useX, xt, yqx), laneSelect(useZ, zqx, wqx));
+    DoubleLanes qy = laneSelect(useXY, laneSelect(useX, xqy, yt), laneSelect(useZ, zqy, wqy));
+    DoubleLanes qz = laneSelect(useXY, laneSelect(useX, xqz, yqz), laneSelect(useZ, zt, wqz));
+    DoubleLanes qw = laneSelect(useXY, laneSelect(useX, xqw, yqw), laneSelect(useZ, zqw, wt));
+
+    DoubleLanes qn = lanes(0.5) / laneSqrt(t);
+    float columns[10][DoubleLanes::count];
+    storeLanes(m[12], columns[0]);
+    storeLanes(m[13], columns[1]);
+    storeLanes(m[14], columns[2]);
+    storeLanes(qx * qn, columns[3]);
+    storeLanes(qy * qn, columns[4]);
+    storeLanes(qz * qn, columns[5]);
+    storeLanes(qw * qn, columns[6]);
+    storeLanes(sx, columns[7]);
+    storeLanes(sy, columns[8]);
+    storeLanes(sz, columns[9]);
+    for (int lane = 0; lane < n; lane++) {
+        for (int c = 0; c < 3; c++) translation[3 * lane + c] = columns[c][lane];
+        for (int c = 0; c < 4; c++) rotation[4 * lane + c] = columns[3 + c][lane];
+        for (int c = 0; c < 3; c++) scale[3 * lane + c] = columns[7 + c][lane];
+    }
+}
+
+// invertMatrix for DoubleLanes::count matrices. Returns false if any of them is singular, those are left unwritten.
+static bool invertMatrixLanes(const ofbx::Matrix *mats, ofbx::Matrix *out) {
+    const int n = DoubleLanes::count;
+    DoubleLanes m[16], inv[16];
+    for (int c = 0; c < 4; c++) loadColumnLanes(mats, c, &m[4 * c]);
+    invertCofactors(m, inv);
+    DoubleLanes det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+
+    double dets[DoubleLanes::count];
+    double scaled[16][DoubleLanes::count];
+    storeLanes(det, dets);
+    DoubleLanes invDet = lanes(1.0) / det;
+    for (int c = 0; c < 16; c++) {
+        storeLanes(inv[c] * invDet, scaled[c]);
+    }
+    bool invertible = true;
+    for (int lane = 0; lane < n; lane++) {
+        if (dets[lane] == 0) {
+            invertible = false;
+            continue;
+        }
+        for (int c = 0; c < 16; c++) out[lane].m[c] = scaled[c][lane];
+    }
+    return invertible;
+}
+
+#endif
+
+// out[i] = a[i * aStride] * b[i * bStride], so a stride of 0 multiplies every matrix by the same one.
+// out may be the same array as a or b.
+static void mulMatrices(const ofbx::Matrix *a, int aStride, const ofbx::Matrix *b, int bStride, ofbx::Matrix *out, int count) {
+    for (int i = 0; i < count; i++, a += aStride, b += bStride) {
+#if MATHUTIL_AVX
+        __m256d aCol[4];
+        for (int c = 0; c < 4; c++) aCol[c] = _mm256_loadu_pd(&a->m[4 * c]);
+        __m256d result[4];
+        for (int d = 0; d < 4; d++) {
+            __m256d sum = _mm256_setzero_pd();
+            for (int c = 0; c < 4; c++) {
+                sum = _mm256_add_pd(sum, _mm256_mul_pd(aCol[c], _mm256_set1_pd(b->m[4 * d + c])));
+            }
+            result[d] = sum;
+        }
+        for (int d = 0; d < 4; d++) _mm256_storeu_pd(&out[i].m[4 * d], result[d]);
+#elif MATHUTIL_SSE2
+        __m128d aLo[4], aHi[4];
+        for (int c = 0; c < 4; c++) {
+            aLo[c] = _mm_loadu_pd(&a->m[4 * c]);
+            aHi[c] = _mm_loadu_pd(&a->m[4 * c + 2]);
+        }
+        __m128d lo[4], hi[4];
+        for (int d = 0; d < 4; d++) {
+            __m128d sumLo = _mm_setzero_pd(), sumHi = _mm_setzero_pd();
+            for (int c = 0; c < 4; c++) {
+                __m128d component = _mm_set1_pd(b->m[4 * d + c]);
+                sumLo = _mm_add_pd(sumLo, _mm_mul_pd(aLo[c], component));
+                sumHi = _mm_add_pd(sumHi, _mm_mul_pd(aHi[c], component));
+            }
+            lo[d] = sumLo;
+            hi[d] = sumHi;
+        }
+        for (int d = 0; d < 4; d++) {
+            _mm_storeu_pd(&out[i].m[4 * d], lo[d]);
+            _mm_storeu_pd(&out[i].m[4 * d + 2], hi[d]);
+        }
+#else
+        out[i] = mul(a, b);
+#endif
+    }
+}
+
+// extractTransform for count matrices, into arrays of 3, 4 and 3 floats per matrix.
+static void extractTransforms(const ofbx::Matrix *mats, int count, float *translations, float *rotations, float *scales) {
+    int c = 0;
+#if MATHUTIL_AVX || MATHUTIL_SSE2
+    for (; c + DoubleLanes::count <= count; c += DoubleLanes::count) {
+        extractTransformLanes(&mats[c], &translations[3 * c], &rotations[4 * c], &scales[3 * c]);
+    }
+#endif
+    for (; c < count; c++) {
+        extractTransform(&mats[c], &translations[3 * c], &rotations[4 * c], &scales[3 * c]);
+    }
+}
+
+// invertMatrix for count matrices. Returns false if any of them is singular, those are left unwritten.
+static bool invertMatrices(const ofbx::Matrix *mats, ofbx::Matrix *out, int count) {
+    bool invertible = true;
+    int c = 0;
+#if MATHUTIL_AVX || MATHUTIL_SSE2
+    for (; c + DoubleLanes::count <= count; c += DoubleLanes::count) {
+        if (!invertMatrixLanes(&mats[c], &out[c])) invertible = false;
+    }
+#endif
+    for (; c < count; c++) {
+        if (!invertMatrix(&mats[c], &out[c])) invertible = false;
+    }
+    return invertible;
+}
+
 #endif //PB_FBX_CONV_MATHUTIL_H
@@ -6,6 +6,7 @@
 #define PB_FBX_CONV_MODEL_H
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <cassert>
 #include "types.h"
@@ -37,10 +38,12 @@ namespace ofbx {
 #define ATTR_BLENDWEIGHT6   (1<<20)
 #define ATTR_BLENDWEIGHT7   (1<<21)
 #define ATTR_MAX            (1<<22)
+#define ATTR_COUNT          22
 #define MAX_TEX_COORDS      8
 #define MAX_BLEND_WEIGHTS   8
 // Adding a new attribute? Don't forget to update...
 // - calculateVertexSize(Attributes)
+// - calculateAttributeBytes(Attributes, Format)
 typedef u32 Attributes;
 
 static const char *attributeNames[] = {
@@ -49,6 +52,21 @@ static const char *attributeNames[] = {
         "BLENDWEIGHT0", "BLENDWEIGHT1", "BLENDWEIGHT2", "BLENDWEIGHT3", "BLENDWEIGHT4", "BLENDWEIGHT5", "BLENDWEIGHT6", "BLENDWEIGHT7"
 };
 
+// Component formats for quantized vertex buffers. The number of components comes from the attribute.
+#define FORMAT_FLOAT        0   // 32 bit float
+#define FORMAT_HALF         1   // 16 bit float
+#define FORMAT_UNORM16      2   // u16 / 65535, remapped by the mesh's bounds for positions and tex coords
+#define FORMAT_UNORM8       3   // u8 / 255
+#define FORMAT_OCT16        4   // unit vector, octahedral encoded into 2 s16 / 32767
+#define FORMAT_OCT8         5   // unit vector, octahedral encoded into 2 s8 / 127
+#define FORMAT_SKIN8        6   // blend weights only, u8 palette index and u8 / 255 weight, see calculateSkinBytes
+#define FORMAT_SKIN16       7   // blend weights only, u8 palette index and u16 / 65535 weight
+typedef u32 Format;
+
+static const char *formatNames[] = {
+        "FLOAT", "HALF", "UNORM16", "UNORM8", "OCT16", "OCT8", "SKIN8", "SKIN16"
+};
+
 #define USAGE_NONE           1
 #define USAGE_DIFFUSE        2
 #define USAGE_EMISSIVE       3
@@ -87,6 +105,7 @@ struct ModelTexture {
 };
 
 struct ModelMaterial {
+    const ofbx::Object *source = nullptr; // the fbx material this was converted from, null for the default material
     std::string id;
     bool lambertOnly = false;
     f32 ambient[3]  = {1,1,1};
@@ -100,16 +119,27 @@ struct ModelMaterial {
 
 struct MeshPart {
     std::string id;
-    std::vector<u16> indices;
+    std::vector<u32> indices;
     u32 primitive;
+    u32 indexWidth = 16; // bits per index when written, see chooseIndexWidths
+    u32 lod = 0; // level of detail, 0 is full detail
 };
 
 struct ModelMesh {
     Attributes attributes;
     u16 vertexSize;
-    int vertexHashes[65536]; // small enough that we can just put all of it here.
+    std::unordered_map<int, std::vector<u32>> vertexLookup; // vertex hash -> vertices with that hash, for deduplication
     std::vector<float> vertices;
     std::vector<MeshPart> parts;
+
+    // Byte oriented copy of the vertices, only filled in when a quantization profile is selected.
+    // formats and offsets are indexed by attribute bit. Each attribute is padded to 4 bytes.
+    std::vector<u8> packedVertices;
+    u16 packedVertexSize = 0; // in bytes, 0 if the mesh isn't quantized
+    Format formats[ATTR_COUNT] = {0};
+    u16 offsets[ATTR_COUNT] = {0};
+    f32 positionBounds[6] = {0, 0, 0, 1, 1, 1}; // min, extent for FORMAT_UNORM16 positions
+    f32 texCoordBounds[4] = {0, 0, 1, 1};       // min, extent for FORMAT_UNORM16 tex coords
 };
 
 struct BoneBinding {
@@ -123,6 +153,8 @@ struct NodePart {
     std::string meshPartID;
     std::string materialID;
     std::vector<BoneBinding> bones;
+    u32 lod = 0; // matches MeshPart::lod of the referenced part
+    const ofbx::Object *attachTo = nullptr; // during conversion, the bone this rigid part moves under
 };
 
 struct Node {
@@ -135,6 +167,33 @@ struct Node {
     float scale[3];
 };
 
+#define CHANNEL_TRANSLATION 0
+#define CHANNEL_ROTATION    1
+#define CHANNEL_SCALE       2
+
+static const char *channelNames[] = {
+        "translation", "rotation", "scale"
+};
+
+// One channel of one node with its own key times, see reduceKeyframes.
+struct AnimationTrack {
+    u32 node;    // index into Animation::nodeIDs
+    u32 channel; // CHANNEL_*
+    std::vector<f32> times;  // seconds from the start of the animation, empty for a key at every frame (see dedupAnimations)
+    std::vector<f32> values; // 3 (translation, scale) or 4 (rotation) components per key
+
+    // Bit packed copy of the values, only filled in when animations are compressed. See compressTrack.
+    bool compressed = false;
+    u32 bits = 0;                 // bits per quantized component
+    f32 min[3] = {0, 0, 0};       // range of translation and scale components, or of the smallest three rotation ones
+    f32 extent[3] = {0, 0, 0};
+    std::vector<u8> packed;
+
+    // An identical track, of this or an earlier animation, that is written instead of this one's keys. See dedupAnimations.
+    s32 refAnimation = -1;
+    s32 refTrack = -1;
+};
+
 struct Animation {
     std::string id;
     u32 stride;
@@ -143,6 +202,10 @@ struct Animation {
     std::vector<std::string> nodeIDs;
     std::vector<s32> nodeFormats; // note: Changing this to s16/u16 would break model loading. Doesn't really matter because these arrays are small.
     std::vector<f32> nodeData;
+    std::vector<AnimationTrack> tracks; // if not empty, the animation is keyed per track and nodeData is unused
+    bool planar = false; // nodeData and track values are component major instead of frame major, see planarizeAnimations
+    bool additive = false; // channels are relative to the node's local transform, see makeAnimationsAdditive
+    std::string alias; // id of an identical earlier animation, written instead of this one's data. See dedupAnimations.
 };
 
 struct Model {
@@ -172,6 +235,31 @@ inline u16 calculateVertexSize(Attributes attributes) {
 #undef checkAttribute
 }
 
+// size in bytes of a single attribute in the given format, padded to 4 bytes
+inline u16 calculateAttributeBytes(Attributes attribute, Format format) {
+    if (attribute == ATTR_COLORPACKED) return 4;
+    if (format == FORMAT_SKIN8 || format == FORMAT_SKIN16) return 0; // stored together, see calculateSkinBytes
+    u16 components = calculateVertexSize(attribute);
+    u16 bytes;
+    switch (format) {
+        case FORMAT_HALF:
+        case FORMAT_UNORM16: bytes = u16(components * 2); break;
+        case FORMAT_UNORM8:  bytes = components; break;
+        case FORMAT_OCT16:   bytes = 4; break;
+        case FORMAT_OCT8:    bytes = 2; break;
+        default:             bytes = u16(components * 4); break;
+    }
+    return u16((bytes + 3) & ~3);
+}
+
+// Packed blend weights are stored as one block at the first blend weight's offset: every palette index as a u8,
+// padded to 4 bytes, followed by every weight, padded to 4 bytes.
+inline u16 calculateSkinBytes(int nBlendWeights, Format format) {
+    u16 indexBytes = u16((nBlendWeights + 3) & ~3);
+    u16 weightBytes = u16(nBlendWeights * (format == FORMAT_SKIN16 ? 2 : 1));
+    return u16(indexBytes + ((weightBytes + 3) & ~3));
+}
+
 inline u16 calculateVertexOffset(Attributes attributes, Attributes attribute) {
     assert(attribute != 0 && (attribute & (attribute - 1)) == 0); // ensure attribute is a power of 2
     Attributes attrsBefore = attributes & (attribute - 1);
@@ -1483,6 +1483,12 @@ struct AnimationCurveNodeImpl : AnimationCurveNode
 	}
 
 
+	const AnimationCurve* getCurve(int index) const override
+	{
+		return curves[index].curve;
+	}
+
+
 	struct Curve
 	{
 		const AnimationCurve* curve = nullptr;
@@ -2647,6 +2653,83 @@ Matrix Object::evalLocal(const Vec3& translation, const Vec3& rotation, const Ve
 }
 
 
+static bool isIdentity(const Matrix& mtx)
+{
+	Matrix identity = makeIdentity();
+	for (int i = 0; i < 16; ++i)
+	{
+		if (mtx.m[i] != identity.m[i]) return false;
+	}
+	return true;
+}
+
+
+LocalTransformEvaluator Object::compileLocal() const
+{
+	LocalTransformEvaluator out;
+	out.rotation_order = getRotationOrder();
+	out.translation = getLocalTranslation();
+	out.rotation = getLocalRotation();
+	out.scaling = getLocalScaling();
+
+	Vec3 rotation_pivot = getRotationPivot();
+	Vec3 scaling_pivot = getScalingPivot();
+
+	Matrix r_off = makeIdentity();
+	setTranslation(getRotationOffset(), &r_off);
+	Matrix r_p = makeIdentity();
+	setTranslation(rotation_pivot, &r_p);
+	Matrix r_pre = getRotationMatrix(getPreRotation(), RotationOrder::EULER_XYZ);
+	Matrix r_post_inv = getRotationMatrix(-getPostRotation(), RotationOrder::EULER_ZYX);
+	Matrix r_p_inv = makeIdentity();
+	setTranslation(-rotation_pivot, &r_p_inv);
+	Matrix s_off = makeIdentity();
+	setTranslation(getScalingOffset(), &s_off);
+	Matrix s_p = makeIdentity();
+	setTranslation(scaling_pivot, &s_p);
+	Matrix s_p_inv = makeIdentity();
+	setTranslation(-scaling_pivot, &s_p_inv);
+
+	for (const Matrix* mtx : {&r_off, &r_p, &r_pre})
+	{
+		if (!isIdentity(*mtx)) out.pre[out.pre_count++] = *mtx;
+	}
+	for (const Matrix* mtx : {&r_post_inv, &r_p_inv, &s_off, &s_p})
+	{
+		if (!isIdentity(*mtx)) out.post[out.post_count++] = *mtx;
+	}
+	if (!isIdentity(s_p_inv)) out.tail[out.tail_count++] = s_p_inv;
+	return out;
+}
+
+
+Matrix LocalTransformEvaluator::evalRotation(const Vec3& rotation) const
+{
+	return getRotationMatrix(rotation, rotation_order);
+}
+
+
+Matrix LocalTransformEvaluator::eval(const Vec3& translation, const Vec3& rotation, const Vec3& scaling) const
+{
+	Matrix s = makeIdentity();
+	s.m[0] = scaling.x;
+	s.m[5] = scaling.y;
+	s.m[10] = scaling.z;
+
+	Matrix t = makeIdentity();
+	setTranslation(translation, &t);
+
+	// same order as evalLocal: t * r_off * r_p * r_pre * r * r_post_inv * r_p_inv * s_off * s_p * s * s_p_inv
+	Matrix result = t;
+	for (int i = 0; i < pre_count; ++i) result = result * pre[i];
+	result = result * evalRotation(rotation);
+	for (int i = 0; i < post_count; ++i) result = result * post[i];
+	result = result * s;
+	for (int i = 0; i < tail_count; ++i) result = result * tail[i];
+	return result;
+}
+
+
 Vec3 Object::getLocalTranslation() const
 {
 	return resolveVec3Property(*this, "Lcl Translation", {0, 0, 0});
@@ -138,6 +138,26 @@ enum class RotationOrder {
 };
 
 
+// Object::evalLocal with the constant factors looked up once, see Object::compileLocal.
+// Identity factors are skipped, everything else is multiplied in the same order, so results match evalLocal exactly.
+struct LocalTransformEvaluator
+{
+	RotationOrder rotation_order;
+	Vec3 translation; // the object's local transform, for channels that aren't animated
+	Vec3 rotation;
+	Vec3 scaling;
+	int pre_count = 0;
+	int post_count = 0;
+	int tail_count = 0;
+	Matrix pre[3];  // rotation offset, rotation pivot, pre rotation
+	Matrix post[4]; // inverse post rotation, inverse rotation pivot, scaling offset, scaling pivot
+	Matrix tail[1]; // inverse scaling pivot
+
+	Matrix eval(const Vec3& translation, const Vec3& rotation, const Vec3& scaling) const;
+	Matrix evalRotation(const Vec3& rotation) const;
+};
+
+
 struct AnimationCurveNode;
 struct AnimationLayer;
 struct Scene;
@@ -188,6 +208,7 @@ struct Object
 	Matrix getGlobalTransform() const;
 	Matrix evalLocal(const Vec3& translation, const Vec3& rotation) const;
 	Matrix evalLocal(const Vec3& translation, const Vec3& rotation, const Vec3& scale) const;
+	LocalTransformEvaluator compileLocal() const;
 	bool isNode() const { return is_node; }
 
 
@@ -341,6 +362,7 @@ struct AnimationCurveNode : Object
 	AnimationCurveNode(const Scene& _scene, const IElement& _element);
 
 	virtual Vec3 getNodeLocalTransform(double time, Vec3 fallback) const = 0;
+	virtual const AnimationCurve* getCurve(int index) const = 0; // x, y or z, nullptr when that component isn't animated
 };
 
 
@@ -377,4 +399,4 @@ IScene* load(const u8* data, int size);
 const char* getError();
 
 
-} // namespace ofbx
\ No newline at end of file
+} // namespace ofbx
\ No newline at end of file
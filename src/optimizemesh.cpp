@@ -0,0 +1,600 @@
+//
+// Created on 10/18/26.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "optimizemesh.h"
+
+
+// ---------------------- Cache Statistics ------------------------
+
+void measureVertexCache(const u32 *indices, u32 nIndices, u32 nVertices, CacheStats *stats) {
+    // simulate a FIFO cache. timestamps[v] is the miss count when v was last put into the cache.
+    std::vector<u32> timestamps(nVertices, 0);
+    std::vector<bool> seen(nVertices, false);
+    u32 misses = 0;
+    u32 unique = 0;
+    for (u32 c = 0; c < nIndices; c++) {
+        u32 v = indices[c];
+        if (!seen[v]) {
+            seen[v] = true;
+            unique++;
+        } else if (misses - timestamps[v] < VCACHE_FIFO_SIZE) {
+            continue; // hit
+        }
+        timestamps[v] = misses;
+        misses++;
+    }
+    stats->triangles += nIndices / 3;
+    stats->vertices += unique;
+    stats->misses += misses;
+}
+
+
+// ---------------------- Triangle Order ------------------------
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+
+const int forsythCacheSize = 32;
+const float forsythCacheDecayPower = 1.5f;
+const float forsythLastTriScore = 0.75f;
+const float forsythValenceBoostScale = 2.0f;
+const float forsythValenceBoostPower = 0.5f;
+
+struct ForsythVertex {
+    float score = 0;
+    s32 cachePos = -1;
+    u32 remaining = 0;  // number of unemitted triangles using this vertex
+    u32 firstTri = 0;   // offset of this vertex's triangles in the adjacency list
+};
+
+static float forsythScore(const ForsythVertex &v) {
+    if (v.remaining == 0) return -1.0f; // no triangles left, this vertex doesn't matter
+
+    float score = 0;
+    if (v.cachePos >= 0) {
+        if (v.cachePos < 3) {
+            // the last triangle's vertices get a fixed score, so we don't favor re-using the same edge.
+            score = forsythLastTriScore;
+        } else {
+            const float scaler = 1.0f / (forsythCacheSize - 3);
+            score = powf(1.0f - (v.cachePos - 3) * scaler, forsythCacheDecayPower);
+        }
+    }
+
+    // bonus for vertices with few triangles left, so we finish them off instead of leaving lone triangles.
+    score += forsythValenceBoostScale * powf(float(v.remaining), -forsythValenceBoostPower);
+    return score;
+}
+
+void optimizeVertexCache(u32 *indices, u32 nIndices, u32 nVertices) {
+    u32 nTris = nIndices / 3;
+    if (nTris < 2) return;
+
+    // build vertex -> triangle adjacency
+    std::vector<ForsythVertex> verts(nVertices);
+    for (u32 c = 0; c < nTris * 3; c++) {
+        verts[indices[c]].remaining++;
+    }
+    u32 offset = 0;
+    for (ForsythVertex &v : verts) {
+        v.firstTri = offset;
+        offset += v.remaining;
+        v.remaining = 0;
+    }
+    std::vector<u32> adjacency(offset);
+    for (u32 t = 0; t < nTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            ForsythVertex &v = verts[indices[t*3 + k]];
+            adjacency[v.firstTri + v.remaining++] = t;
+        }
+    }
+
+    for (ForsythVertex &v : verts) {
+        v.score = forsythScore(v);
+    }
+    std::vector<float> triScores(nTris);
+    std::vector<bool> emitted(nTris, false);
+    s32 bestTri = -1;
+    float bestScore = -1;
+    for (u32 t = 0; t < nTris; t++) {
+        triScores[t] = verts[indices[t*3+0]].score + verts[indices[t*3+1]].score + verts[indices[t*3+2]].score;
+        if (triScores[t] > bestScore) {
+            bestScore = triScores[t];
+            bestTri = t;
+        }
+    }
+
+    std::vector<u32> output;
+    output.reserve(nTris * 3);
+    u32 cache[forsythCacheSize + 3];
+    u32 cacheCount = 0;
+    u32 scanCursor = 0;
+
+    while (output.size() < nTris * 3) {
+        if (bestTri < 0) {
+            // nothing in the cache scored, fall back to the best remaining triangle.
+            bestScore = -1;
+            for (u32 t = scanCursor; t < nTris; t++) {
+                if (emitted[t]) {
+                    if (t == scanCursor) scanCursor++;
+                    continue;
+                }
+                if (triScores[t] > bestScore) {
+                    bestScore = triScores[t];
+                    bestTri = t;
+                }
+            }
+        }
+
+        // emit the triangle and remove it from the adjacency lists
+        u32 tri = u32(bestTri);
+        emitted[tri] = true;
+        u32 *triVerts = &indices[tri * 3];
+        for (int k = 0; k < 3; k++) {
+            output.push_back(triVerts[k]);
+            ForsythVertex &v = verts[triVerts[k]];
+            u32 *tris = &adjacency[v.firstTri];
+            for (u32 c = 0; c < v.remaining; c++) {
+                if (tris[c] == tri) {
+                    tris[c] = tris[--v.remaining];
+                    break;
+                }
+            }
+        }
+
+        // push the triangle's vertices to the front of the LRU cache
+        u32 newCache[forsythCacheSize + 3];
+        u32 newCount = 0;
+        for (int k = 0; k < 3; k++) {
+            newCache[newCount++] = triVerts[k];
+        }
+        for (u32 c = 0; c < cacheCount; c++) {
+            u32 v = cache[c];
+            if (v != triVerts[0] && v != triVerts[1] && v != triVerts[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+        // anything past the end of the cache gets evicted
+        for (u32 c = forsythCacheSize; c < newCount; c++) {
+            verts[newCache[c]].cachePos = -1;
+            verts[newCache[c]].score = forsythScore(verts[newCache[c]]);
+        }
+        cacheCount = newCount < forsythCacheSize ? newCount : forsythCacheSize;
+        memcpy(cache, newCache, cacheCount * sizeof(u32));
+
+        // rescore the cached vertices and their triangles, and pick the next triangle from them
+        for (u32 c = 0; c < cacheCount; c++) {
+            ForsythVertex &v = verts[cache[c]];
+            v.cachePos = s32(c);
+            float oldScore = v.score;
+            v.score = forsythScore(v);
+            float delta = v.score - oldScore;
+            for (u32 d = 0; d < v.remaining; d++) {
+                triScores[adjacency[v.firstTri + d]] += delta;
+            }
+        }
+        for (u32 c = newCount > forsythCacheSize ? forsythCacheSize : newCount; c < newCount; c++) {
+            // evicted vertices were rescored above, but their triangles weren't
+            ForsythVertex &v = verts[newCache[c]];
+            for (u32 d = 0; d < v.remaining; d++) {
+                u32 t = adjacency[v.firstTri + d];
+                triScores[t] = verts[indices[t*3+0]].score + verts[indices[t*3+1]].score + verts[indices[t*3+2]].score;
+            }
+        }
+        bestTri = -1;
+        bestScore = -1;
+        for (u32 c = 0; c < cacheCount; c++) {
+            ForsythVertex &v = verts[cache[c]];
+            for (u32 d = 0; d < v.remaining; d++) {
+                u32 t = adjacency[v.firstTri + d];
+                if (triScores[t] > bestScore) {
+                    bestScore = triScores[t];
+                    bestTri = t;
+                }
+            }
+        }
+    }
+
+    assert(output.size() == nTris * 3);
+    memcpy(indices, output.data(), output.size() * sizeof(u32));
+}
+
+
+// ---------------------- Vertex Order ------------------------
+
+// Reorders the vertices of the mesh to the order in which the parts first use them, so vertex fetch walks memory linearly.
+void optimizeVertexFetch(ModelMesh *mesh) {
+    u32 vSize = mesh->vertexSize;
+    u32 nVerts = u32(mesh->vertices.size() / vSize);
+    std::vector<s32> remap(nVerts, -1);
+    u32 next = 0;
+    for (MeshPart &part : mesh->parts) {
+        for (u32 &index : part.indices) {
+            if (remap[index] < 0) remap[index] = next++;
+            index = u32(remap[index]);
+        }
+    }
+    // keep any unreferenced vertices at the end
+    for (u32 c = 0; c < nVerts; c++) {
+        if (remap[c] < 0) remap[c] = next++;
+    }
+
+    std::vector<float> vertices(mesh->vertices.size());
+    for (u32 c = 0; c < nVerts; c++) {
+        memcpy(&vertices[remap[c] * vSize], &mesh->vertices[c * vSize], vSize * sizeof(float));
+    }
+    mesh->vertices.swap(vertices);
+    for (auto &entry : mesh->vertexLookup) {
+        for (u32 &index : entry.second) index = u32(remap[index]);
+        std::sort(entry.second.begin(), entry.second.end());
+    }
+}
+
+
+// ---------------------- Overdraw ------------------------
+// Pedro Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+// https://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+
+static void rasterizeTriangle(const float *a, const float *b, const float *c, float *depth, OverdrawStats *stats) {
+    float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    if (area == 0) return;
+    float invArea = 1.0f / area;
+
+    int minX = int(std::max(0.0f, floorf(std::min(a[0], std::min(b[0], c[0])))));
+    int minY = int(std::max(0.0f, floorf(std::min(a[1], std::min(b[1], c[1])))));
+    int maxX = int(std::min(float(OVERDRAW_GRID_SIZE - 1), ceilf(std::max(a[0], std::max(b[0], c[0])))));
+    int maxY = int(std::min(float(OVERDRAW_GRID_SIZE - 1), ceilf(std::max(a[1], std::max(b[1], c[1])))));
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            // barycentrics, normalized so that we don't care about winding
+            float wa = ((b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px)) * invArea;
+            float wb = ((c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px)) * invArea;
+            float wc = 1.0f - wa - wb;
+            if (wa < 0 || wb < 0 || wc < 0) continue;
+
+            float z = wa * a[2] + wb * b[2] + wc * c[2];
+            float &d = depth[y * OVERDRAW_GRID_SIZE + x];
+            if (z < d) {
+                if (d == FLT_MAX) stats->covered++;
+                stats->shaded++;
+                d = z;
+            }
+        }
+    }
+}
+
+void measureOverdraw(const ModelMesh *mesh, OverdrawStats *stats) {
+    if (!(mesh->attributes & ATTR_POSITION)) return;
+    u32 vSize = mesh->vertexSize;
+    u32 nVerts = u32(mesh->vertices.size() / vSize);
+    if (nVerts == 0) return;
+
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (u32 c = 0; c < nVerts; c++) {
+        const float *p = &mesh->vertices[c * vSize];
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+    if (extent == 0) return;
+    float scale = (OVERDRAW_GRID_SIZE - 1) / extent;
+
+    std::vector<float> projected(nVerts * 3);
+    std::vector<float> depth(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+
+    // view along each axis, from both sides
+    for (int axis = 0; axis < 3; axis++) {
+        for (int sign = -1; sign <= 1; sign += 2) {
+            int ax = (axis + 1) % 3;
+            int ay = (axis + 2) % 3;
+            for (u32 c = 0; c < nVerts; c++) {
+                const float *p = &mesh->vertices[c * vSize];
+                projected[c*3 + 0] = (p[ax] - lo[ax]) * scale;
+                projected[c*3 + 1] = (p[ay] - lo[ay]) * scale;
+                projected[c*3 + 2] = (p[axis] - lo[axis]) * sign;
+            }
+            std::fill(depth.begin(), depth.end(), FLT_MAX);
+            for (const MeshPart &part : mesh->parts) {
+                if (part.primitive != PRIMITIVETYPE_TRIANGLES) continue;
+                const u32 *indices = part.indices.data();
+                for (size_t c = 0; c + 2 < part.indices.size(); c += 3) {
+                    rasterizeTriangle(&projected[indices[c+0] * 3], &projected[indices[c+1] * 3],
+                                      &projected[indices[c+2] * 3], depth.data(), stats);
+                }
+            }
+        }
+    }
+}
+
+struct TriCluster {
+    u32 start;
+    u32 end;
+    float sortKey;
+};
+
+// Splits the triangle sequence into clusters at points where the simulated cache is cold anyway (hard boundaries),
+// then splits those further wherever the running ACMR of the cluster is already within threshold of the whole cluster's ACMR.
+static void findClusters(const u32 *indices, u32 nTris, u32 nVertices, float threshold, std::vector<TriCluster> &clusters) {
+    std::vector<u32> timestamps(nVertices, 0);
+    u32 time = VCACHE_FIFO_SIZE + 1;
+    auto misses = [&](u32 tri) {
+        int m = 0;
+        for (int k = 0; k < 3; k++) {
+            u32 v = indices[tri * 3 + k];
+            if (time - timestamps[v] > VCACHE_FIFO_SIZE) {
+                timestamps[v] = time++;
+                m++;
+            }
+        }
+        return m;
+    };
+
+    // the first cluster always starts at 0, even if the first triangle is degenerate and can't miss 3 times
+    std::vector<u32> hard(1, 0);
+    for (u32 t = 0; t < nTris; t++) {
+        if (misses(t) == 3 && t > 0) hard.push_back(t);
+    }
+    hard.push_back(nTris);
+
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        u32 start = hard[h];
+        u32 end = hard[h+1];
+
+        time += VCACHE_FIFO_SIZE + 1; // flush
+        u32 clusterMisses = 0;
+        for (u32 t = start; t < end; t++) clusterMisses += misses(t);
+        float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+        time += VCACHE_FIFO_SIZE + 1;
+        u32 softStart = start;
+        u32 runningMisses = 0;
+        for (u32 t = start; t < end; t++) {
+            runningMisses += misses(t);
+            if (float(runningMisses) / float(t + 1 - softStart) <= clusterThreshold) {
+                clusters.push_back({softStart, t + 1, 0});
+                softStart = t + 1;
+                runningMisses = 0;
+                time += VCACHE_FIFO_SIZE + 1;
+            }
+        }
+        if (softStart < end) clusters.push_back({softStart, end, 0});
+    }
+}
+
+void optimizeOverdraw(u32 *indices, u32 nIndices, const float *vertices, u32 nVertices, u32 vertexSize, float threshold) {
+    u32 nTris = nIndices / 3;
+    if (nTris < 2) return;
+
+    std::vector<TriCluster> clusters;
+    findClusters(indices, nTris, nVertices, threshold, clusters);
+    if (clusters.size() < 2) return;
+
+    // mesh centroid, weighted by area
+    double meshCentroid[3] = {0, 0, 0};
+    double meshArea = 0;
+    std::vector<float> clusterData(clusters.size() * 6); // centroid, normal
+    for (TriCluster &cluster : clusters) {
+        double centroid[3] = {0, 0, 0};
+        double normal[3] = {0, 0, 0};
+        double clusterArea = 0;
+        for (u32 t = cluster.start; t < cluster.end; t++) {
+            const float *a = &vertices[indices[t*3+0] * vertexSize];
+            const float *b = &vertices[indices[t*3+1] * vertexSize];
+            const float *c = &vertices[indices[t*3+2] * vertexSize];
+            double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            double n[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+            double area = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            for (int k = 0; k < 3; k++) {
+                centroid[k] += (a[k] + b[k] + c[k]) * (area / 3);
+                normal[k] += n[k];
+            }
+            clusterArea += area;
+        }
+        float *cd = &clusterData[(&cluster - &clusters[0]) * 6];
+        double inv = clusterArea == 0 ? 0 : 1 / clusterArea;
+        double nlen = sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+        double ninv = nlen == 0 ? 0 : 1 / nlen;
+        for (int k = 0; k < 3; k++) {
+            cd[k] = float(centroid[k] * inv);
+            cd[k+3] = float(normal[k] * ninv);
+            meshCentroid[k] += centroid[k];
+        }
+        meshArea += clusterArea;
+    }
+    for (int k = 0; k < 3; k++) meshCentroid[k] = meshArea == 0 ? 0 : meshCentroid[k] / meshArea;
+
+    // clusters that face away from the center of the mesh are likely to occlude others, draw them first.
+    for (TriCluster &cluster : clusters) {
+        float *cd = &clusterData[(&cluster - &clusters[0]) * 6];
+        float key = 0;
+        for (int k = 0; k < 3; k++) key += float(cd[k] - meshCentroid[k]) * cd[k+3];
+        cluster.sortKey = key;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const TriCluster &a, const TriCluster &b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<u32> output;
+    output.reserve(nTris * 3);
+    for (TriCluster &cluster : clusters) {
+        output.insert(output.end(), &indices[cluster.start * 3], &indices[cluster.end * 3]);
+    }
+    memcpy(indices, output.data(), nTris * 3 * sizeof(u32));
+}
+
+
+// ---------------------- Triangle Strips ------------------------
+
+typedef std::unordered_map<u64, std::vector<u32>> EdgeMap;
+
+static inline u64 edgeKey(u32 a, u32 b) {
+    return u64(a) << 32 | b;
+}
+
+// finds an unused triangle containing the directed edge a->b, and returns its third vertex.
+static s32 findNextTri(const EdgeMap &edges, const std::vector<bool> &used, u32 a, u32 b, u32 *tri) {
+    auto it = edges.find(edgeKey(a, b));
+    if (it == edges.end()) return -1;
+    for (u32 t : it->second) {
+        if (!used[t]) {
+            *tri = t;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Grows a strip from the given triangle, starting with its vertices rotated by rotation.
+// Triangle k of a strip is (s[k], s[k+1], s[k+2]) for even k and (s[k+1], s[k], s[k+2]) for odd k, so winding is preserved.
+static void growStrip(const u32 *indices, const EdgeMap &edges, std::vector<bool> &used, u32 start, int rotation,
+                      std::vector<u32> &strip, std::vector<u32> &tris) {
+    strip.clear();
+    tris.clear();
+    for (int k = 0; k < 3; k++) {
+        strip.push_back(indices[start * 3 + (k + rotation) % 3]);
+    }
+    tris.push_back(start);
+    used[start] = true;
+
+    while (true) {
+        size_t n = strip.size();
+        bool even = ((n - 2) & 1) == 0;
+        u32 a = even ? strip[n-2] : strip[n-1];
+        u32 b = even ? strip[n-1] : strip[n-2];
+        u32 tri;
+        if (findNextTri(edges, used, a, b, &tri) < 0) break;
+
+        // the new vertex is the one following b in the triangle
+        const u32 *t = &indices[tri * 3];
+        int k = 0;
+        while (t[k] != b || t[(k + 2) % 3] != a) k++;
+        strip.push_back(t[(k + 1) % 3]);
+        tris.push_back(tri);
+        used[tri] = true;
+    }
+
+    for (u32 t : tris) used[t] = false; // the caller decides which attempt to keep
+}
+
+// Converts a triangle list to a single strip joined with degenerate triangles.
+// Returns false and leaves the part unchanged if the strip wouldn't be smaller than the list.
+bool stripifyPart(MeshPart *part) {
+    if (part->primitive != PRIMITIVETYPE_TRIANGLES) return false;
+    const u32 *indices = part->indices.data();
+    u32 nTris = u32(part->indices.size() / 3);
+    if (nTris < 2) return false;
+
+    EdgeMap edges;
+    for (u32 t = 0; t < nTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            edges[edgeKey(indices[t*3 + k], indices[t*3 + (k+1)%3])].push_back(t);
+        }
+    }
+
+    std::vector<bool> used(nTris, false);
+    std::vector<u32> output;
+    std::vector<u32> strip, bestStrip;
+    std::vector<u32> tris, bestTris;
+    // start strips in the existing triangle order, so we keep most of the vertex cache locality
+    for (u32 t = 0; t < nTris; t++) {
+        if (used[t]) continue;
+
+        bestStrip.clear();
+        for (int rotation = 0; rotation < 3; rotation++) {
+            growStrip(indices, edges, used, t, rotation, strip, tris);
+            if (strip.size() > bestStrip.size()) {
+                bestStrip.swap(strip);
+                bestTris.swap(tris);
+            }
+        }
+        for (u32 tri : bestTris) used[tri] = true;
+
+        if (!output.empty()) {
+            // join with degenerates, and make sure the new strip starts on an even triangle
+            output.push_back(output.back());
+            output.push_back(bestStrip[0]);
+            if (output.size() & 1) output.push_back(bestStrip[0]);
+        }
+        output.insert(output.end(), bestStrip.begin(), bestStrip.end());
+    }
+
+    if (output.size() >= part->indices.size()) return false;
+    part->indices.swap(output);
+    part->primitive = PRIMITIVETYPE_TRIANGLESTRIP;
+    return true;
+}
+
+
+// ---------------------- Driver ------------------------
+
+static void measureMesh(ModelMesh *mesh, CacheStats *stats) {
+    u32 nVerts = u32(mesh->vertices.size() / mesh->vertexSize);
+    for (MeshPart &part : mesh->parts) {
+        if (part.primitive != PRIMITIVETYPE_TRIANGLES) continue;
+        measureVertexCache(part.indices.data(), u32(part.indices.size()), nVerts, stats);
+    }
+}
+
+static void optimizeCache(ModelMesh *mesh, int meshIdx, Options *opts) {
+    bool overdraw = opts->overdrawThreshold > 0;
+    u32 nVerts = u32(mesh->vertices.size() / mesh->vertexSize);
+
+    CacheStats before, after;
+    OverdrawStats overdrawBefore, overdrawAfter;
+    measureMesh(mesh, &before);
+    if (overdraw) measureOverdraw(mesh, &overdrawBefore);
+    for (MeshPart &part : mesh->parts) {
+        if (part.primitive != PRIMITIVETYPE_TRIANGLES) continue;
+        optimizeVertexCache(part.indices.data(), u32(part.indices.size()), nVerts);
+        if (overdraw && (mesh->attributes & ATTR_POSITION)) {
+            optimizeOverdraw(part.indices.data(), u32(part.indices.size()), mesh->vertices.data(), nVerts,
+                             mesh->vertexSize, opts->overdrawThreshold);
+        }
+    }
+    optimizeVertexFetch(mesh);
+    measureMesh(mesh, &after);
+
+    printf("Mesh %d vertex cache (FIFO %d): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", meshIdx, VCACHE_FIFO_SIZE,
+           before.acmr(), after.acmr(), before.atvr(), after.atvr());
+    if (overdraw) {
+        measureOverdraw(mesh, &overdrawAfter);
+        printf("Mesh %d overdraw (%dx%d, 6 views): %.3f -> %.3f\n", meshIdx, OVERDRAW_GRID_SIZE, OVERDRAW_GRID_SIZE,
+               overdrawBefore.overdraw(), overdrawAfter.overdraw());
+    }
+}
+
+static void stripifyMesh(ModelMesh *mesh, int meshIdx) {
+    size_t listIndices = 0, outIndices = 0;
+    int nStrips = 0;
+    for (MeshPart &part : mesh->parts) {
+        if (part.primitive != PRIMITIVETYPE_TRIANGLES) continue;
+        listIndices += part.indices.size();
+        if (stripifyPart(&part)) nStrips++;
+        outIndices += part.indices.size();
+    }
+    printf("Mesh %d: %d/%d parts converted to triangle strips, %d -> %d indices\n", meshIdx, nStrips,
+           int(mesh->parts.size()), int(listIndices), int(outIndices));
+}
+
+void optimizeMeshes(Model *model, Options *opts) {
+    for (ModelMesh &mesh : model->meshes) {
+        int meshIdx = int(&mesh - &model->meshes[0]);
+        if (opts->optimizeVertexCache) optimizeCache(&mesh, meshIdx, opts);
+        if (opts->triangleStrips) stripifyMesh(&mesh, meshIdx);
+    }
+}
@@ -0,0 +1,48 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_OPTIMIZEMESH_H
+#define PB_FBX_CONV_OPTIMIZEMESH_H
+
+#include "model.h"
+#include "args.h"
+
+// Size of the FIFO cache used to measure ACMR/ATVR. Matches the small post-transform caches on mobile GPUs.
+#define VCACHE_FIFO_SIZE 16
+
+struct CacheStats {
+    u32 triangles = 0;
+    u32 vertices = 0;
+    u32 misses = 0;
+    float acmr() const { return triangles ? float(misses) / triangles : 0; } // average cache miss ratio, misses per triangle
+    float atvr() const { return vertices ? float(misses) / vertices : 0; }   // average transform to vertex ratio, 1.0 is optimal
+};
+
+void measureVertexCache(const u32 *indices, u32 nIndices, u32 nVertices, CacheStats *stats);
+void optimizeVertexCache(u32 *indices, u32 nIndices, u32 nVertices);
+void optimizeVertexFetch(ModelMesh *mesh);
+
+// Resolution of the CPU rasterizer used to estimate overdraw.
+#define OVERDRAW_GRID_SIZE 256
+
+struct OverdrawStats {
+    u64 covered = 0; // pixels covered by at least one triangle
+    u64 shaded = 0;  // pixels that passed the depth test, including the first
+    float overdraw() const { return covered ? float(shaded) / covered : 0; } // 1.0 is optimal
+};
+
+// Rasterizes the mesh's triangle list parts in order from a fixed set of view directions, with a depth test.
+void measureOverdraw(const ModelMesh *mesh, OverdrawStats *stats);
+// Splits the (cache optimized) triangles of a part into clusters, allowing each cluster's ACMR to be at most threshold
+// times the ACMR of the original sequence, then sorts the clusters so that outward facing ones are drawn first.
+void optimizeOverdraw(u32 *indices, u32 nIndices, const float *vertices, u32 nVertices, u32 vertexSize, float threshold);
+
+// Converts a triangle list part to a triangle strip, joining strips with degenerate triangles.
+// Returns false and leaves the part as a list if that wouldn't reduce the number of indices.
+bool stripifyPart(MeshPart *part);
+
+// Runs the enabled optimization passes over every mesh in the model.
+void optimizeMeshes(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_OPTIMIZEMESH_H
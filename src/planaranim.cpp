@@ -0,0 +1,39 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cstdio>
+#include <vector>
+#include "planaranim.h"
+
+// Transposes rows x columns values in place, using one copy.
+static void transpose(std::vector<f32> &values, size_t rows, size_t columns) {
+    std::vector<f32> transposed(values.size());
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < columns; c++) {
+            transposed[c * rows + r] = values[r * columns + c];
+        }
+    }
+    values.swap(transposed);
+}
+
+void planarizeAnimations(Model *model, Options *opts) {
+    if (!opts->planarAnimations) return;
+    if (!opts->p3db) {
+        printf("Warning: the planar animation layout is only written with p3db animations (-a), ignoring -P\n");
+        return;
+    }
+    for (Animation &anim : model->animations) {
+        if (anim.planar || !anim.alias.empty()) continue;
+        if (anim.tracks.empty()) {
+            transpose(anim.nodeData, anim.frames, anim.stride);
+        } else {
+            for (AnimationTrack &track : anim.tracks) {
+                if (track.compressed || track.refAnimation >= 0) continue;
+                size_t width = track.channel == CHANNEL_ROTATION ? 4 : 3;
+                transpose(track.values, track.values.size() / width, width);
+            }
+        }
+        anim.planar = true;
+    }
+}
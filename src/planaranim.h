@@ -0,0 +1,16 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_PLANARANIM_H
+#define PB_FBX_CONV_PLANARANIM_H
+
+#include "model.h"
+#include "args.h"
+
+// With opts->planarAnimations and p3db output, transposes every animation to the planar layout: nodeData holds all
+// frames of its first component, then all frames of the second and so on, and uncompressed track values hold all
+// keys' x, then all y, z (and w). Compressed tracks keep their packed keys. See Animation::planar.
+void planarizeAnimations(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_PLANARANIM_H
@@ -0,0 +1,319 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "quantizemesh.h"
+
+
+// ---------------------- Encodings ------------------------
+
+// round to nearest even, like a hardware conversion would.
+u16 floatToHalf(float value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u32 sign = (bits >> 16) & 0x8000;
+    u32 abs = bits & 0x7FFFFFFF;
+
+    if (abs >= 0x7F800000) return u16(sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0)); // inf or nan
+    if (abs >= 0x477FF000) return u16(sign | 0x7C00); // rounds up to inf
+    if (abs < 0x38800000) {
+        // subnormal half
+        if (abs < 0x33000000) return u16(sign);
+        u32 exponent = abs >> 23;
+        u32 mantissa = (abs & 0x7FFFFF) | 0x800000;
+        u32 shift = 126 - exponent;
+        u32 result = mantissa >> shift;
+        u32 rem = mantissa & ((1u << shift) - 1);
+        u32 halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (result & 1))) result++;
+        return u16(sign | result);
+    }
+    u32 result = (abs - 0x38000000) >> 13; // rebias the exponent from 127 to 15
+    u32 rem = abs & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (result & 1))) result++;
+    return u16(sign | result);
+}
+
+float halfToFloat(u16 half) {
+    u32 sign = u32(half & 0x8000) << 16;
+    u32 exponent = (half >> 10) & 0x1F;
+    u32 mantissa = half & 0x3FF;
+    float result;
+    if (exponent == 0) {
+        result = ldexpf(float(mantissa), -24);
+    } else if (exponent == 31) {
+        result = mantissa ? NAN : INFINITY;
+    } else {
+        result = ldexpf(float(mantissa | 0x400), int(exponent) - 25);
+    }
+    u32 bits;
+    memcpy(&bits, &result, sizeof(bits));
+    bits |= sign;
+    memcpy(&result, &bits, sizeof(bits));
+    return result;
+}
+
+static inline float signNotZero(float v) {
+    return v < 0 ? -1.0f : 1.0f;
+}
+
+// "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.
+void encodeOctahedral(const float *normal, float *out) {
+    float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (l1 == 0) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = normal[0] / l1;
+    float y = normal[1] / l1;
+    if (normal[2] < 0) {
+        float fx = (1 - fabsf(y)) * signNotZero(x);
+        float fy = (1 - fabsf(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    out[0] = x;
+    out[1] = y;
+}
+
+void decodeOctahedral(const float *oct, float *normal) {
+    float x = oct[0];
+    float y = oct[1];
+    float z = 1 - fabsf(x) - fabsf(y);
+    if (z < 0) {
+        float fx = (1 - fabsf(y)) * signNotZero(x);
+        float fy = (1 - fabsf(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    float len = sqrtf(x*x + y*y + z*z);
+    normal[0] = x / len;
+    normal[1] = y / len;
+    normal[2] = z / len;
+}
+
+static inline float clamp(float v, float lo, float hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// vertex buffers are little endian, like the GPUs that read them.
+static inline void put16(u8 *&out, u16 v) {
+    out[0] = u8(v);
+    out[1] = u8(v >> 8);
+    out += 2;
+}
+
+static inline void put32(u8 *&out, u32 v) {
+    out[0] = u8(v);
+    out[1] = u8(v >> 8);
+    out[2] = u8(v >> 16);
+    out[3] = u8(v >> 24);
+    out += 4;
+}
+
+static void encodeAttribute(const float *in, int components, Format format, const float *boundsMin,
+                            const float *boundsExtent, u8 *out) {
+    switch (format) {
+        case FORMAT_HALF:
+            for (int c = 0; c < components; c++) put16(out, floatToHalf(in[c]));
+            break;
+        case FORMAT_UNORM16:
+            for (int c = 0; c < components; c++) {
+                float n = boundsExtent[c] == 0 ? 0 : (in[c] - boundsMin[c]) / boundsExtent[c];
+                put16(out, u16(lroundf(clamp(n, 0, 1) * 65535.0f)));
+            }
+            break;
+        case FORMAT_UNORM8:
+            for (int c = 0; c < components; c++) {
+                *out++ = u8(lroundf(clamp(in[c], 0, 1) * 255.0f));
+            }
+            break;
+        case FORMAT_OCT16:
+        case FORMAT_OCT8: {
+            float oct[2];
+            encodeOctahedral(in, oct);
+            if (format == FORMAT_OCT16) {
+                put16(out, u16(s16(lroundf(clamp(oct[0], -1, 1) * 32767.0f))));
+                put16(out, u16(s16(lroundf(clamp(oct[1], -1, 1) * 32767.0f))));
+            } else {
+                *out++ = u8(s8(lroundf(clamp(oct[0], -1, 1) * 127.0f)));
+                *out++ = u8(s8(lroundf(clamp(oct[1], -1, 1) * 127.0f)));
+            }
+            break;
+        }
+        default: {
+            for (int c = 0; c < components; c++) {
+                u32 bits;
+                memcpy(&bits, &in[c], sizeof(bits));
+                put32(out, bits);
+            }
+            break;
+        }
+    }
+}
+
+
+// ---------------------- Meshes ------------------------
+
+#define ALL_BLENDWEIGHTS (ATTR_BLENDWEIGHT0 * 0xFF)
+
+static Format chooseFormat(Attributes attribute, int profile, int weightBits) {
+    if (attribute & ALL_BLENDWEIGHTS) {
+        if (weightBits == 8) return FORMAT_SKIN8;
+        if (weightBits == 16) return FORMAT_SKIN16;
+        return FORMAT_FLOAT;
+    }
+    if (profile == QUANTIZE_NONE) return FORMAT_FLOAT;
+    switch (attribute) {
+        case ATTR_POSITION:
+            return profile == QUANTIZE_HALF ? FORMAT_HALF : FORMAT_UNORM16;
+        case ATTR_NORMAL:
+        case ATTR_TANGENT:
+        case ATTR_BINORMAL:
+            return profile == QUANTIZE_COMPACT ? FORMAT_OCT8 : FORMAT_OCT16;
+        case ATTR_COLOR:
+            return FORMAT_UNORM8;
+        default:
+            break;
+    }
+    if (attribute >= ATTR_TEXCOORD0 && attribute <= ATTR_TEXCOORD7) {
+        return profile == QUANTIZE_HALF ? FORMAT_HALF : FORMAT_UNORM16;
+    }
+    return FORMAT_FLOAT; // packed colors
+}
+
+#define ALL_TEXCOORDS (ATTR_TEXCOORD0 * 0xFF)
+
+// bounds across every attribute in mask, laid out as min followed by extent.
+static void computeBounds(const ModelMesh *mesh, Attributes mask, int components, float *bounds) {
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    u16 vSize = mesh->vertexSize;
+    for (Attributes f = 1; f < ATTR_MAX; f <<= 1) {
+        if (!(mesh->attributes & mask & f)) continue;
+        u16 offset = calculateVertexOffset(mesh->attributes, f);
+        for (size_t v = offset; v < mesh->vertices.size(); v += vSize) {
+            for (int c = 0; c < components; c++) {
+                lo[c] = fminf(lo[c], mesh->vertices[v + c]);
+                hi[c] = fmaxf(hi[c], mesh->vertices[v + c]);
+            }
+        }
+    }
+    for (int c = 0; c < components; c++) {
+        if (lo[c] > hi[c]) lo[c] = hi[c] = 0;
+        bounds[c] = lo[c];
+        bounds[components + c] = hi[c] - lo[c];
+    }
+}
+
+// Quantizes the (palette index, weight) pairs of a vertex. Weights are rounded individually and then whatever
+// the sum lost or gained to rounding goes on the largest weight, so the packed weights still sum to exactly 1.
+static void encodeSkin(const float *in, int nWeights, Format format, u8 *out) {
+    u32 maxValue = format == FORMAT_SKIN16 ? 65535 : 255;
+    u32 weights[MAX_BLEND_WEIGHTS];
+    u32 sum = 0;
+    int largest = 0;
+    for (int c = 0; c < nWeights; c++) {
+        out[c] = u8(in[2*c]);
+        weights[c] = u32(lroundf(clamp(in[2*c + 1], 0, 1) * maxValue));
+        sum += weights[c];
+        if (in[2*c + 1] > in[2*largest + 1]) largest = c;
+    }
+    if (sum != 0) {
+        s32 fixed = s32(weights[largest]) + s32(maxValue) - s32(sum);
+        weights[largest] = u32(fixed < 0 ? 0 : fixed);
+    }
+
+    out += (nWeights + 3) & ~3;
+    for (int c = 0; c < nWeights; c++) {
+        if (format == FORMAT_SKIN16) put16(out, u16(weights[c]));
+        else *out++ = u8(weights[c]);
+    }
+}
+
+void quantizeMesh(ModelMesh *mesh, int profile, int weightBits) {
+    Attributes attributes = mesh->attributes;
+    int nBlendWeights = 0;
+    u16 skinOffset = 0;
+    u16 offset = 0;
+    for (int c = 0; c < ATTR_COUNT; c++) {
+        Attributes f = Attributes(1) << c;
+        if (!(attributes & f)) continue;
+        Format format = chooseFormat(f, profile, weightBits);
+        mesh->formats[c] = format;
+        if (format == FORMAT_SKIN8 || format == FORMAT_SKIN16) {
+            if (nBlendWeights == 0) skinOffset = offset;
+            mesh->offsets[c] = skinOffset;
+            nBlendWeights++;
+        } else {
+            mesh->offsets[c] = offset;
+            offset += calculateAttributeBytes(f, format);
+        }
+    }
+    Format skinFormat = weightBits == 16 ? FORMAT_SKIN16 : FORMAT_SKIN8;
+    if (nBlendWeights != 0) {
+        // blend weights are always the last attributes, so the block doesn't move anything.
+        offset += calculateSkinBytes(nBlendWeights, skinFormat);
+    }
+    mesh->packedVertexSize = offset;
+
+    if (attributes & ATTR_POSITION) computeBounds(mesh, ATTR_POSITION, 3, mesh->positionBounds);
+    if (attributes & ALL_TEXCOORDS) computeBounds(mesh, ALL_TEXCOORDS, 2, mesh->texCoordBounds);
+
+    u32 nVerts = u32(mesh->vertices.size() / mesh->vertexSize);
+    mesh->packedVertices.assign(size_t(nVerts) * mesh->packedVertexSize, 0);
+    for (u32 v = 0; v < nVerts; v++) {
+        const float *vertex = &mesh->vertices[v * mesh->vertexSize];
+        u8 *packed = &mesh->packedVertices[v * mesh->packedVertexSize];
+        for (int c = 0; c < ATTR_COUNT; c++) {
+            Attributes f = Attributes(1) << c;
+            if (!(attributes & f)) continue;
+            if (nBlendWeights != 0 && (f & ALL_BLENDWEIGHTS)) continue;
+            const float *in = vertex + calculateVertexOffset(attributes, f);
+            u8 *out = packed + mesh->offsets[c];
+            int components = calculateVertexSize(f);
+            if (f == ATTR_POSITION) {
+                encodeAttribute(in, components, mesh->formats[c], &mesh->positionBounds[0], &mesh->positionBounds[3], out);
+            } else {
+                encodeAttribute(in, components, mesh->formats[c], &mesh->texCoordBounds[0], &mesh->texCoordBounds[2], out);
+            }
+        }
+        if (nBlendWeights != 0) {
+            const float *in = vertex + calculateVertexOffset(attributes, ATTR_BLENDWEIGHT0);
+            encodeSkin(in, nBlendWeights, skinFormat, packed + skinOffset);
+        }
+    }
+}
+
+void quantizeMeshes(Model *model, Options *opts) {
+    if (opts->quantization == QUANTIZE_NONE && opts->packedWeightBits == 0) return;
+    for (ModelMesh &mesh : model->meshes) {
+        quantizeMesh(&mesh, opts->quantization, opts->packedWeightBits);
+        printf("Mesh %d quantized (%s, %d bit weights): %d -> %d bytes per vertex\n", int(&mesh - &model->meshes[0]),
+               quantizationProfileNames[opts->quantization], opts->packedWeightBits ? opts->packedWeightBits : 32,
+               mesh.vertexSize * 4, mesh.packedVertexSize);
+    }
+}
+
+void chooseIndexWidths(Model *model, Options *opts) {
+    u32 counts[3] = {0, 0, 0};
+    for (ModelMesh &mesh : model->meshes) {
+        for (MeshPart &part : mesh.parts) {
+            u32 maxIndex = 0;
+            for (u32 index : part.indices) {
+                if (index > maxIndex) maxIndex = index;
+            }
+            if (opts->wideIndices && maxIndex < 256) part.indexWidth = 8;
+            else if (maxIndex < 65536) part.indexWidth = 16;
+            else part.indexWidth = 32;
+            counts[part.indexWidth == 8 ? 0 : part.indexWidth == 16 ? 1 : 2]++;
+        }
+    }
+    if (opts->wideIndices) {
+        printf("Index widths: %d parts with 8 bits, %d with 16 bits, %d with 32 bits\n", counts[0], counts[1], counts[2]);
+    }
+}
@@ -0,0 +1,35 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_QUANTIZEMESH_H
+#define PB_FBX_CONV_QUANTIZEMESH_H
+
+#include "model.h"
+#include "args.h"
+
+#define QUANTIZE_NONE       0   // 32 bit floats everywhere
+#define QUANTIZE_HALF       1   // half positions and uvs, 16 bit octahedral normals
+#define QUANTIZE_NORM16     2   // 16 bit normalized positions and uvs in per-mesh bounds, 16 bit octahedral normals
+#define QUANTIZE_COMPACT    3   // like NORM16, but with 8 bit octahedral normals and tangents
+
+static const char *quantizationProfileNames[] = {
+        "none", "half", "norm16", "compact"
+};
+#define QUANTIZE_PROFILE_COUNT 4
+
+u16 floatToHalf(float value);
+float halfToFloat(u16 half);
+void encodeOctahedral(const float *normal, float *out);
+void decodeOctahedral(const float *oct, float *normal);
+
+// Chooses the formats for the mesh's attributes from the profile and fills in packedVertices.
+// weightBits of 8 or 16 packs the blend weights as FORMAT_SKIN8 / FORMAT_SKIN16, 0 leaves them as floats.
+void quantizeMesh(ModelMesh *mesh, int profile, int weightBits);
+// Quantizes every mesh in the model according to opts->quantization and opts->packedWeightBits.
+void quantizeMeshes(Model *model, Options *opts);
+// Sets MeshPart::indexWidth for every part. Parts use 16 bit indices unless opts->wideIndices is set, in which case
+// each part gets the smallest of 8, 16 or 32 bits that fits its largest index.
+void chooseIndexWidths(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_QUANTIZEMESH_H
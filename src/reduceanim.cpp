@@ -0,0 +1,154 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "reduceanim.h"
+
+static inline int channelWidth(u32 channel) {
+    return channel == CHANNEL_ROTATION ? 4 : 3;
+}
+
+void buildTracks(Animation *anim) {
+    if (!anim->tracks.empty()) return;
+    u32 nNodes = u32(anim->nodeIDs.size());
+    u32 stride = anim->stride;
+    for (u32 n = 0; n < nNodes; n++) {
+        for (u32 channel = CHANNEL_TRANSLATION; channel <= CHANNEL_SCALE; channel++) {
+            s32 offset = anim->nodeFormats[3*n + channel];
+            if (offset < 0) continue;
+            int width = channelWidth(channel);
+
+            anim->tracks.emplace_back();
+            AnimationTrack &track = anim->tracks.back();
+            track.node = n;
+            track.channel = channel;
+            track.times.resize(anim->frames);
+            track.values.resize(anim->frames * width);
+            for (u32 frame = 0; frame < anim->frames; frame++) {
+                track.times[frame] = frame * anim->samplingRate;
+                const float *src = &anim->nodeData[frame * stride + offset];
+                float *dst = &track.values[frame * width];
+                for (int c = 0; c < width; c++) dst[c] = src[c];
+                if (channel == CHANNEL_ROTATION && frame > 0) {
+                    const float *prev = dst - 4;
+                    if (prev[0]*dst[0] + prev[1]*dst[1] + prev[2]*dst[2] + prev[3]*dst[3] < 0) {
+                        for (int c = 0; c < 4; c++) dst[c] = -dst[c];
+                    }
+                }
+            }
+        }
+    }
+    anim->nodeData.clear();
+    anim->nodeData.shrink_to_fit();
+}
+
+static void slerp(const float *a, const float *b, float t, float *out) {
+    float d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+    float sign = d < 0 ? -1.0f : 1.0f;
+    d = fabsf(d);
+    float wa, wb;
+    if (d > 0.9995f) {
+        // nearly parallel, lerp and normalize below
+        wa = 1 - t;
+        wb = t;
+    } else {
+        float theta = acosf(d);
+        float invSin = 1.0f / sinf(theta);
+        wa = sinf((1 - t) * theta) * invSin;
+        wb = sinf(t * theta) * invSin;
+    }
+    wb *= sign;
+    float len = 0;
+    for (int c = 0; c < 4; c++) {
+        out[c] = wa * a[c] + wb * b[c];
+        len += out[c] * out[c];
+    }
+    len = 1.0f / sqrtf(len);
+    for (int c = 0; c < 4; c++) out[c] *= len;
+}
+
+float trackKeyError(u32 channel, const float *expected, const float *actual) {
+    if (channel == CHANNEL_ROTATION) {
+        // in doubles, acos is too coarse near 1 in floats for small tolerances
+        double d = 0, le = 0, la = 0;
+        for (int c = 0; c < 4; c++) {
+            d += double(expected[c]) * actual[c];
+            le += double(expected[c]) * expected[c];
+            la += double(actual[c]) * actual[c];
+        }
+        d = le > 0 && la > 0 ? fabs(d) / sqrt(le * la) : 1;
+        return d >= 1 ? 0 : float(2 * acos(d));
+    }
+    float dx = expected[0] - actual[0], dy = expected[1] - actual[1], dz = expected[2] - actual[2];
+    return sqrtf(dx*dx + dy*dy + dz*dz);
+}
+
+// Checks whether interpolating between keys a and b reproduces every key between them.
+static bool segmentFits(const AnimationTrack *track, u32 a, u32 b, float maxError) {
+    int width = channelWidth(track->channel);
+    const float *va = &track->values[a * width];
+    const float *vb = &track->values[b * width];
+    float span = track->times[b] - track->times[a];
+    float interpolated[4];
+    for (u32 k = a + 1; k < b; k++) {
+        float t = span > 0 ? (track->times[k] - track->times[a]) / span : 0;
+        if (track->channel == CHANNEL_ROTATION) {
+            slerp(va, vb, t, interpolated);
+        } else {
+            for (int c = 0; c < 3; c++) interpolated[c] = va[c] + (vb[c] - va[c]) * t;
+        }
+        if (trackKeyError(track->channel, &track->values[k * width], interpolated) > maxError) return false;
+    }
+    return true;
+}
+
+void reduceTrack(AnimationTrack *track, float maxError) {
+    u32 nKeys = u32(track->times.size());
+    if (nKeys <= 1) return;
+    int width = channelWidth(track->channel);
+
+    std::vector<u32> keep;
+    bool constant = true;
+    for (u32 k = 1; k < nKeys && constant; k++) {
+        constant = trackKeyError(track->channel, &track->values[0], &track->values[k * width]) <= maxError;
+    }
+    if (constant) {
+        keep.push_back(0);
+    } else {
+        // greedily extend each segment as far as interpolation stays within the error
+        keep.push_back(0);
+        u32 a = 0;
+        for (u32 b = 2; b < nKeys; b++) {
+            if (!segmentFits(track, a, b, maxError)) {
+                a = b - 1;
+                keep.push_back(a);
+            }
+        }
+        keep.push_back(nKeys - 1);
+    }
+
+    for (u32 c = 0; c < keep.size(); c++) {
+        track->times[c] = track->times[keep[c]];
+        for (int d = 0; d < width; d++) track->values[c * width + d] = track->values[keep[c] * width + d];
+    }
+    track->times.resize(keep.size());
+    track->values.resize(keep.size() * width);
+}
+
+void reduceKeyframes(Model *model, Options *opts) {
+    if (opts->keyError <= 0) return;
+    float angleError = float(opts->keyAngleError * M_PI / 180.0);
+    for (Animation &anim : model->animations) {
+        buildTracks(&anim);
+        size_t before = 0, after = 0;
+        for (AnimationTrack &track : anim.tracks) {
+            before += track.times.size();
+            reduceTrack(&track, track.channel == CHANNEL_ROTATION ? angleError : opts->keyError);
+            after += track.times.size();
+        }
+        printf("Animation %s: %d tracks, reduced %d keys to %d\n", anim.id.c_str(), int(anim.tracks.size()), int(before), int(after));
+    }
+}
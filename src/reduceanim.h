@@ -0,0 +1,27 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_REDUCEANIM_H
+#define PB_FBX_CONV_REDUCEANIM_H
+
+#include "model.h"
+#include "args.h"
+
+// Moves the uniformly sampled nodeData of an animation into tracks with a key at every frame.
+// Rotations are flipped onto the hemisphere of the previous key so that interpolation takes the short way.
+void buildTracks(Animation *anim);
+
+// Distance between two translation or scale keys, or the angle in radians between two rotation keys.
+float trackKeyError(u32 channel, const float *expected, const float *actual);
+
+// Removes the keys of a track that interpolating between the keys around them reproduces within maxError
+// (distance for translations and scales, angle in radians for rotations, which are slerped).
+// Tracks that don't change beyond the error keep a single key.
+void reduceTrack(AnimationTrack *track, float maxError);
+
+// With opts->keyError, converts every animation to tracks and reduces their keys. Translations and scales are kept
+// within opts->keyError, rotations within opts->keyAngleError degrees.
+void reduceKeyframes(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_REDUCEANIM_H
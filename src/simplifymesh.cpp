@@ -0,0 +1,455 @@
+//
+// Created on 10/18/26.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include "simplifymesh.h"
+
+// Collapses between vertices whose normals are further apart than this (cosine) are rejected.
+const float lodNormalThreshold = 0.7f;
+// Collapses between vertices whose blend weights differ by more than this (L1 distance) are rejected.
+const float lodSkinThreshold = 0.1f;
+
+enum VertexKind {
+    KIND_MANIFOLD, // single wedge, interior. Can collapse anywhere.
+    KIND_SEAM,     // two wedges (uv or normal seam), interior. Can collapse along the seam.
+    KIND_LOCKED,   // border or corner. Never moves.
+};
+
+struct Quadric {
+    // symmetric 4x4 matrix: a00 a01 a02 a11 a12 a22, b0 b1 b2, c
+    double a[6] = {0, 0, 0, 0, 0, 0};
+    double b[3] = {0, 0, 0};
+    double c = 0;
+    double weight = 0; // total weight of the planes, eval divides by it to get a squared distance
+
+    void addPlane(const double *n, double d, double weight) {
+        this->weight += weight;
+        a[0] += weight * n[0] * n[0]; a[1] += weight * n[0] * n[1]; a[2] += weight * n[0] * n[2];
+        a[3] += weight * n[1] * n[1]; a[4] += weight * n[1] * n[2]; a[5] += weight * n[2] * n[2];
+        b[0] += weight * n[0] * d; b[1] += weight * n[1] * d; b[2] += weight * n[2] * d;
+        c += weight * d * d;
+    }
+    void add(const Quadric &q) {
+        for (int k = 0; k < 6; k++) a[k] += q.a[k];
+        for (int k = 0; k < 3; k++) b[k] += q.b[k];
+        c += q.c;
+        weight += q.weight;
+    }
+    double eval(const float *p) const {
+        double x = p[0], y = p[1], z = p[2];
+        double r = a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + a[3]*y*y + 2*a[4]*y*z + a[5]*z*z;
+        r += 2 * (b[0]*x + b[1]*y + b[2]*z) + c;
+        return r <= 0 || weight <= 0 ? 0 : r / weight;
+    }
+};
+
+struct Collapse {
+    u32 v;
+    u32 u;
+    double cost;
+};
+
+struct SimplifyState {
+    const ModelMesh *mesh;
+    u32 nVerts;
+    u16 normalOffset;
+    u16 weightOffset;
+    u16 nWeights;
+    std::vector<u32> positionIDs;           // wedge -> unique position
+    std::vector<std::vector<u32>> wedges;   // unique position -> wedges
+    std::vector<Quadric> quadrics;          // unique position -> quadric
+};
+
+static inline const float *position(const SimplifyState &s, u32 v) {
+    return &s.mesh->vertices[v * s.mesh->vertexSize];
+}
+
+static void findPositions(SimplifyState &s) {
+    std::unordered_map<u64, std::vector<u32>> buckets;
+    s.positionIDs.resize(s.nVerts);
+    for (u32 v = 0; v < s.nVerts; v++) {
+        const float *p = position(s, v);
+        u32 bits[3];
+        memcpy(bits, p, sizeof(bits));
+        u64 hash = (u64(bits[0]) * 73856093) ^ (u64(bits[1]) * 19349663) ^ (u64(bits[2]) * 83492791);
+        std::vector<u32> &bucket = buckets[hash];
+        s32 id = -1;
+        for (u32 other : bucket) {
+            if (memcmp(position(s, other), p, 3 * sizeof(float)) == 0) {
+                id = s.positionIDs[other];
+                break;
+            }
+        }
+        if (id < 0) {
+            id = s32(s.wedges.size());
+            s.wedges.emplace_back();
+        }
+        bucket.push_back(v);
+        s.positionIDs[v] = u32(id);
+    }
+}
+
+static void computeQuadrics(SimplifyState &s, const std::vector<u32> &indices) {
+    s.quadrics.assign(s.wedges.size(), Quadric());
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const float *p0 = position(s, indices[t+0]);
+        const float *p1 = position(s, indices[t+1]);
+        const float *p2 = position(s, indices[t+2]);
+        double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        double n[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+        double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (len == 0) continue;
+        n[0] /= len; n[1] /= len; n[2] /= len;
+        double d = -(n[0]*p0[0] + n[1]*p0[1] + n[2]*p0[2]);
+        double area = len * 0.5;
+        for (int k = 0; k < 3; k++) {
+            s.quadrics[s.positionIDs[indices[t+k]]].addPlane(n, d, area);
+        }
+    }
+}
+
+static void classifyVertices(const SimplifyState &s, const std::vector<u32> &indices, std::vector<u8> &kinds) {
+    // directed position edges, for finding borders
+    std::unordered_map<u64, int> edges;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        for (int k = 0; k < 3; k++) {
+            u64 a = s.positionIDs[indices[t+k]];
+            u64 b = s.positionIDs[indices[t+(k+1)%3]];
+            edges[a << 32 | b]++;
+        }
+    }
+
+    std::vector<u8> positionKinds(s.wedges.size(), KIND_MANIFOLD);
+    for (size_t p = 0; p < s.wedges.size(); p++) {
+        size_t n = s.wedges[p].size();
+        if (n == 2) positionKinds[p] = KIND_SEAM;
+        else if (n > 2) positionKinds[p] = KIND_LOCKED;
+    }
+    for (auto &edge : edges) {
+        u64 a = edge.first >> 32;
+        u64 b = edge.first & 0xFFFFFFFF;
+        auto twin = edges.find(b << 32 | a);
+        if (twin == edges.end() || edge.second != 1 || twin->second != 1) {
+            // border or non-manifold edge
+            positionKinds[a] = KIND_LOCKED;
+            positionKinds[b] = KIND_LOCKED;
+        }
+    }
+
+    kinds.resize(s.nVerts);
+    for (u32 v = 0; v < s.nVerts; v++) {
+        kinds[v] = positionKinds[s.positionIDs[v]];
+    }
+}
+
+static bool compatibleAttributes(const SimplifyState &s, u32 v, u32 u) {
+    const float *vv = &s.mesh->vertices[v * s.mesh->vertexSize];
+    const float *uv = &s.mesh->vertices[u * s.mesh->vertexSize];
+    if (s.normalOffset != 0xFFFF) {
+        const float *nv = vv + s.normalOffset;
+        const float *nu = uv + s.normalOffset;
+        if (nv[0]*nu[0] + nv[1]*nu[1] + nv[2]*nu[2] < lodNormalThreshold) return false;
+    }
+    if (s.nWeights > 0) {
+        // blend weights are (palette index, weight) pairs
+        const float *wv = vv + s.weightOffset;
+        const float *wu = uv + s.weightOffset;
+        float distance = 0;
+        for (int c = 0; c < s.nWeights; c++) {
+            float matched = 0;
+            for (int d = 0; d < s.nWeights; d++) {
+                if (wu[d*2] == wv[c*2] && wu[d*2+1] != 0) matched = wu[d*2+1];
+            }
+            distance += fabsf(wv[c*2+1] - matched);
+        }
+        for (int d = 0; d < s.nWeights; d++) {
+            bool found = false;
+            for (int c = 0; c < s.nWeights; c++) {
+                if (wv[c*2] == wu[d*2] && wv[c*2+1] != 0) found = true;
+            }
+            if (!found) distance += wu[d*2+1];
+        }
+        if (distance > lodSkinThreshold) return false;
+    }
+    return true;
+}
+
+// returns true if moving v to u's position flips or degenerates any of v's remaining triangles.
+static bool flipsTriangles(const SimplifyState &s, const std::vector<u32> &indices, const std::vector<u32> &vertTris,
+                           const std::vector<u32> &vertTriOffsets, u32 v, u32 u) {
+    const float *target = position(s, u);
+    for (u32 i = vertTriOffsets[v]; i < vertTriOffsets[v+1]; i++) {
+        const u32 *tri = &indices[vertTris[i] * 3];
+        if (tri[0] == u || tri[1] == u || tri[2] == u) continue; // this triangle will be removed
+        int k = tri[0] == v ? 0 : tri[1] == v ? 1 : 2;
+        const float *p0 = position(s, tri[k]);
+        const float *p1 = position(s, tri[(k+1)%3]);
+        const float *p2 = position(s, tri[(k+2)%3]);
+
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float f1[3] = {p1[0] - target[0], p1[1] - target[1], p1[2] - target[2]};
+        float f2[3] = {p2[0] - target[0], p2[1] - target[1], p2[2] - target[2]};
+        float n0[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+        float n1[3] = {f1[1]*f2[2] - f1[2]*f2[1], f1[2]*f2[0] - f1[0]*f2[2], f1[0]*f2[1] - f1[1]*f2[0]};
+        float dot = n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2];
+        float len0 = n0[0]*n0[0] + n0[1]*n0[1] + n0[2]*n0[2];
+        float len1 = n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2];
+        if (dot <= 0.25f * sqrtf(len0 * len1)) return true;
+    }
+    return false;
+}
+
+static void collectNeighborPositions(const SimplifyState &s, const std::vector<u32> &indices, const std::vector<u32> &vertTris,
+                                     const std::vector<u32> &vertTriOffsets, u32 pos, std::vector<u32> &out) {
+    out.clear();
+    for (u32 w : s.wedges[pos]) {
+        for (u32 i = vertTriOffsets[w]; i < vertTriOffsets[w+1]; i++) {
+            const u32 *tri = &indices[vertTris[i] * 3];
+            for (int k = 0; k < 3; k++) {
+                u32 p = s.positionIDs[tri[k]];
+                if (p != pos && std::find(out.begin(), out.end(), p) == out.end()) out.push_back(p);
+            }
+        }
+    }
+}
+
+// The link condition: collapsing an edge keeps the mesh manifold only if the endpoints share exactly
+// the two neighbors opposite the edge.
+static bool preservesTopology(const SimplifyState &s, const std::vector<u32> &indices, const std::vector<u32> &vertTris,
+                              const std::vector<u32> &vertTriOffsets, u32 pv, u32 pu) {
+    std::vector<u32> nv, nu;
+    collectNeighborPositions(s, indices, vertTris, vertTriOffsets, pv, nv);
+    collectNeighborPositions(s, indices, vertTris, vertTriOffsets, pu, nu);
+    int shared = 0;
+    for (u32 p : nv) {
+        if (std::find(nu.begin(), nu.end(), p) != nu.end()) shared++;
+    }
+    return shared <= 2;
+}
+
+// finds the wedge of u's position that shares an edge with v, or -1.
+static s32 findSeamTarget(const SimplifyState &s, const std::vector<u32> &indices, const std::vector<u32> &vertTris,
+                          const std::vector<u32> &vertTriOffsets, u32 v, u32 u) {
+    u32 target = s.positionIDs[u];
+    for (u32 i = vertTriOffsets[v]; i < vertTriOffsets[v+1]; i++) {
+        const u32 *tri = &indices[vertTris[i] * 3];
+        for (int k = 0; k < 3; k++) {
+            if (tri[k] != v && s.positionIDs[tri[k]] == target) return tri[k];
+        }
+    }
+    return -1;
+}
+
+static u32 simplifyPass(SimplifyState &s, std::vector<u32> &indices, u32 targetTris, double maxCost) {
+    u32 nTris = u32(indices.size() / 3);
+
+    std::vector<u8> kinds;
+    classifyVertices(s, indices, kinds);
+
+    // vertex -> triangle adjacency
+    std::vector<u32> vertTriOffsets(s.nVerts + 1, 0);
+    for (u32 index : indices) vertTriOffsets[index + 1]++;
+    for (u32 v = 0; v < s.nVerts; v++) vertTriOffsets[v + 1] += vertTriOffsets[v];
+    std::vector<u32> vertTris(indices.size());
+    std::vector<u32> fill(vertTriOffsets.begin(), vertTriOffsets.end() - 1);
+    for (u32 t = 0; t < nTris; t++) {
+        for (int k = 0; k < 3; k++) vertTris[fill[indices[t*3+k]]++] = t;
+    }
+
+    // gather candidate collapses
+    std::vector<Collapse> collapses;
+    for (u32 t = 0; t < nTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            u32 v = indices[t*3 + k];
+            u32 u = indices[t*3 + (k+1)%3];
+            if (s.positionIDs[v] == s.positionIDs[u]) continue;
+            // consider both directions of the edge
+            for (int dir = 0; dir < 2; dir++) {
+                if (dir) std::swap(v, u);
+                if (kinds[v] == KIND_LOCKED) continue;
+                if (!compatibleAttributes(s, v, u)) continue;
+                double cost = s.quadrics[s.positionIDs[v]].eval(position(s, u));
+                if (cost > maxCost) continue;
+                collapses.push_back({v, u, cost});
+            }
+        }
+    }
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+    // apply the cheapest collapses that don't touch each other
+    std::vector<u32> remap(s.nVerts);
+    for (u32 v = 0; v < s.nVerts; v++) remap[v] = v;
+    std::vector<bool> touched(s.wedges.size(), false);
+    u32 removed = 0;
+    u32 toRemove = nTris > targetTris ? nTris - targetTris : 0;
+    for (Collapse &c : collapses) {
+        if (removed >= toRemove) break;
+        u32 pv = s.positionIDs[c.v];
+        u32 pu = s.positionIDs[c.u];
+        if (touched[pv] || touched[pu]) continue;
+
+        s32 sibling = -1, siblingTarget = -1;
+        if (kinds[c.v] == KIND_SEAM) {
+            // A seam vertex can only move along the seam, taking its other wedge with it.
+            // If the other wedge also borders u's position, the edge is on the seam and we know where to put it.
+            sibling = s.wedges[pv][0] == c.v ? s.wedges[pv][1] : s.wedges[pv][0];
+            siblingTarget = findSeamTarget(s, indices, vertTris, vertTriOffsets, u32(sibling), c.u);
+            if (siblingTarget < 0) continue;
+            if (!compatibleAttributes(s, u32(sibling), u32(siblingTarget))) continue;
+            if (flipsTriangles(s, indices, vertTris, vertTriOffsets, u32(sibling), u32(siblingTarget))) continue;
+        }
+        if (flipsTriangles(s, indices, vertTris, vertTriOffsets, c.v, c.u)) continue;
+        if (!preservesTopology(s, indices, vertTris, vertTriOffsets, pv, pu)) continue;
+
+        remap[c.v] = c.u;
+        if (sibling >= 0) remap[sibling] = u32(siblingTarget);
+        s.quadrics[pu].add(s.quadrics[pv]);
+
+        // lock the neighborhood for the rest of this pass, so that the adjacency we're using stays valid.
+        touched[pv] = touched[pu] = true;
+        for (int w = 0; w < 2; w++) {
+            if (w == 1 && sibling < 0) break;
+            u32 moved = w == 0 ? c.v : u32(sibling);
+            u32 target = w == 0 ? c.u : u32(siblingTarget);
+            for (u32 i = vertTriOffsets[moved]; i < vertTriOffsets[moved+1]; i++) {
+                const u32 *tri = &indices[vertTris[i] * 3];
+                for (int k = 0; k < 3; k++) touched[s.positionIDs[tri[k]]] = true;
+                if (tri[0] == target || tri[1] == target || tri[2] == target) removed++;
+            }
+        }
+    }
+    if (removed == 0) return 0;
+
+    // rebuild the index list, dropping collapsed triangles
+    u32 out = 0;
+    for (u32 t = 0; t < nTris; t++) {
+        u32 a = remap[indices[t*3+0]];
+        u32 b = remap[indices[t*3+1]];
+        u32 c = remap[indices[t*3+2]];
+        if (a == b || b == c || a == c) continue;
+        indices[out++] = a;
+        indices[out++] = b;
+        indices[out++] = c;
+    }
+    indices.resize(out);
+    return removed;
+}
+
+u32 simplifyTriangles(const std::vector<u32> &indices, const ModelMesh *mesh, u32 targetTris, float maxError,
+                      std::vector<u32> &out) {
+    out = indices;
+    if (!(mesh->attributes & ATTR_POSITION)) return u32(out.size());
+
+    SimplifyState s;
+    s.mesh = mesh;
+    s.nVerts = u32(mesh->vertices.size() / mesh->vertexSize);
+    s.normalOffset = (mesh->attributes & ATTR_NORMAL) ? calculateVertexOffset(mesh->attributes, ATTR_NORMAL) : u16(0xFFFF);
+    s.weightOffset = (mesh->attributes & ATTR_BLENDWEIGHT0) ? calculateVertexOffset(mesh->attributes, ATTR_BLENDWEIGHT0) : u16(0);
+    s.nWeights = 0;
+    for (int c = 0; c < MAX_BLEND_WEIGHTS; c++) {
+        if (mesh->attributes & (ATTR_BLENDWEIGHT0 << c)) s.nWeights++;
+    }
+
+    findPositions(s);
+    for (u32 index : indices) {
+        std::vector<u32> &w = s.wedges[s.positionIDs[index]];
+        if (std::find(w.begin(), w.end(), index) == w.end()) w.push_back(index);
+    }
+    computeQuadrics(s, indices);
+
+    double maxCost = double(maxError) * maxError;
+    while (out.size() / 3 > targetTris) {
+        if (simplifyPass(s, out, targetTris, maxCost) == 0) break;
+        // wedges that are no longer referenced shouldn't count towards seams
+        for (std::vector<u32> &w : s.wedges) w.clear();
+        for (u32 index : out) {
+            std::vector<u32> &w = s.wedges[s.positionIDs[index]];
+            if (std::find(w.begin(), w.end(), index) == w.end()) w.push_back(index);
+        }
+    }
+    return u32(out.size());
+}
+
+
+// ---------------------- LOD Chains ------------------------
+
+static void addLodNodePartsRecursive(std::vector<Node> &nodes, const std::string &baseID, const MeshPart &lodPart) {
+    for (Node &node : nodes) {
+        size_t nParts = node.parts.size();
+        for (size_t c = 0; c < nParts; c++) {
+            if (node.parts[c].meshPartID == baseID && node.parts[c].lod == 0) {
+                NodePart np = node.parts[c];
+                np.meshPartID = lodPart.id;
+                np.lod = lodPart.lod;
+                node.parts.push_back(std::move(np));
+            }
+        }
+        addLodNodePartsRecursive(node.children, baseID, lodPart);
+    }
+}
+
+static float meshExtent(const ModelMesh *mesh) {
+    if (!(mesh->attributes & ATTR_POSITION)) return 0;
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t c = 0; c < mesh->vertices.size(); c += mesh->vertexSize) {
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], mesh->vertices[c + k]);
+            hi[k] = std::max(hi[k], mesh->vertices[c + k]);
+        }
+    }
+    return std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+}
+
+void generateLods(Model *model, Options *opts) {
+    if (opts->lodLevels <= 0) return;
+
+    for (ModelMesh &mesh : model->meshes) {
+        float maxError = opts->lodMaxError * meshExtent(&mesh);
+        size_t nParts = mesh.parts.size();
+        for (size_t p = 0; p < nParts; p++) {
+            if (mesh.parts[p].primitive != PRIMITIVETYPE_TRIANGLES || mesh.parts[p].lod != 0) continue;
+            std::string baseID = mesh.parts[p].id;
+            u32 baseTris = u32(mesh.parts[p].indices.size() / 3);
+
+            std::vector<u32> previous = mesh.parts[p].indices;
+            for (int level = 1; level <= opts->lodLevels; level++) {
+                u32 previousTris = u32(previous.size() / 3);
+                u32 target = u32(previousTris * opts->lodRatio);
+                std::vector<u32> simplified;
+                simplifyTriangles(previous, &mesh, target, maxError, simplified);
+                u32 tris = u32(simplified.size() / 3);
+                // stop once simplification stops paying off
+                if (tris == 0 || tris > previousTris * 0.95f) {
+                    printf("Part %s: stopping at %d LODs, LOD %d would have %d/%d triangles\n", baseID.c_str(),
+                           level - 1, level, tris, previousTris);
+                    break;
+                }
+                printf("Part %s LOD %d: %d -> %d triangles (%.1f%%)\n", baseID.c_str(), level, baseTris, tris,
+                       100.0f * tris / baseTris);
+
+                // mesh.parts may reallocate, so don't hold references across this
+                mesh.parts.emplace_back();
+                MeshPart &lodPart = mesh.parts.back();
+                std::stringstream builder;
+                builder << baseID << "_lod" << level;
+                lodPart.id = builder.str();
+                lodPart.primitive = PRIMITIVETYPE_TRIANGLES;
+                lodPart.lod = u32(level);
+                lodPart.indices = simplified;
+                addLodNodePartsRecursive(model->nodes, baseID, lodPart);
+                previous.swap(simplified);
+            }
+        }
+    }
+}
@@ -0,0 +1,23 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_SIMPLIFYMESH_H
+#define PB_FBX_CONV_SIMPLIFYMESH_H
+
+#include "model.h"
+#include "args.h"
+
+// Simplifies a triangle list using quadric error metrics and half edge collapses, so no new vertices are created.
+// Vertices on UV/normal seams only collapse along the seam, mesh borders are locked, and collapses that flip
+// triangles or join vertices with different normals or blend weights are rejected.
+// The cost of a collapse is the area weighted mean squared distance of the new position from the planes of the
+// triangles merged into the vertex, so maxError is a distance in model units. Returns the number of indices in the simplified list.
+u32 simplifyTriangles(const std::vector<u32> &indices, const ModelMesh *mesh, u32 targetTris, float maxError,
+                      std::vector<u32> &out);
+
+// Adds opts->lodLevels simplified copies of every triangle list mesh part (with MeshPart::lod set), and
+// matching NodeParts next to every NodePart that references the original.
+void generateLods(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_SIMPLIFYMESH_H
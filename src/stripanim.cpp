@@ -0,0 +1,128 @@
+//
+// Created on 10/18/26.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "stripanim.h"
+
+static void collectBoneNodes(const std::vector<Node> &nodes, std::unordered_set<std::string> &boneNodes) {
+    for (const Node &node : nodes) {
+        for (const NodePart &np : node.parts) {
+            for (const BoneBinding &bone : np.bones) {
+                boneNodes.insert(bone.nodeID);
+            }
+        }
+        collectBoneNodes(node.children, boneNodes);
+    }
+}
+
+// Returns whether node influences anything, and adds it to influencing if it does.
+static bool markInfluencing(const Node &node, const std::unordered_set<std::string> &boneNodes,
+                            const std::unordered_set<std::string> &keep, std::unordered_set<std::string> &influencing) {
+    bool influences = !node.parts.empty() || boneNodes.count(node.id) || keep.count(node.id);
+    for (const Node &child : node.children) {
+        if (markInfluencing(child, boneNodes, keep, influencing)) influences = true;
+    }
+    if (influences) influencing.insert(node.id);
+    return influences;
+}
+
+// Rebuilds the packed frames with only the nodes in kept.
+static void stripSampledNodes(Animation *anim, const std::vector<bool> &kept) {
+    std::vector<std::string> nodeIDs;
+    std::vector<s32> nodeFormats;
+    std::vector<s32> sourceOffsets; // offset of each kept channel in the old frames, in the new order
+    std::vector<s32> widths;
+    s32 stride = 0;
+    for (u32 n = 0; n < anim->nodeIDs.size(); n++) {
+        if (!kept[n]) continue;
+        nodeIDs.push_back(anim->nodeIDs[n]);
+        for (u32 channel = CHANNEL_TRANSLATION; channel <= CHANNEL_SCALE; channel++) {
+            s32 offset = anim->nodeFormats[3*n + channel];
+            if (offset < 0) {
+                nodeFormats.push_back(-1);
+                continue;
+            }
+            s32 width = channel == CHANNEL_ROTATION ? 4 : 3;
+            nodeFormats.push_back(stride);
+            sourceOffsets.push_back(offset);
+            widths.push_back(width);
+            stride += width;
+        }
+    }
+
+    std::vector<f32> nodeData(size_t(stride) * anim->frames);
+    for (u32 frame = 0; frame < anim->frames; frame++) {
+        const f32 *src = &anim->nodeData[size_t(frame) * anim->stride];
+        f32 *dst = &nodeData[size_t(frame) * stride];
+        for (size_t c = 0; c < widths.size(); c++) {
+            memcpy(dst, &src[sourceOffsets[c]], widths[c] * sizeof(f32));
+            dst += widths[c];
+        }
+    }
+
+    anim->nodeIDs.swap(nodeIDs);
+    anim->nodeFormats.swap(nodeFormats);
+    anim->nodeData.swap(nodeData);
+    anim->stride = u32(stride);
+}
+
+// Drops the tracks of the nodes that aren't kept and renumbers the rest.
+static void stripTrackNodes(Animation *anim, const std::vector<bool> &kept) {
+    std::vector<u32> remap(anim->nodeIDs.size());
+    std::vector<std::string> nodeIDs;
+    for (u32 n = 0; n < anim->nodeIDs.size(); n++) {
+        remap[n] = u32(nodeIDs.size());
+        if (kept[n]) nodeIDs.push_back(anim->nodeIDs[n]);
+    }
+    std::vector<AnimationTrack> tracks;
+    for (AnimationTrack &track : anim->tracks) {
+        if (!kept[track.node]) continue;
+        track.node = remap[track.node];
+        tracks.push_back(std::move(track));
+    }
+    anim->nodeIDs.swap(nodeIDs);
+    anim->tracks.swap(tracks);
+}
+
+void stripUnusedAnimation(Model *model, Options *opts) {
+    if (!opts->stripUnusedNodes) return;
+
+    std::unordered_set<std::string> boneNodes, influencing;
+    std::unordered_set<std::string> keep(opts->keepNodes.begin(), opts->keepNodes.end());
+    collectBoneNodes(model->nodes, boneNodes);
+    for (const Node &node : model->nodes) {
+        markInfluencing(node, boneNodes, keep, influencing);
+    }
+
+    std::unordered_set<std::string> stripped;
+    for (Animation &anim : model->animations) {
+        std::vector<bool> kept(anim.nodeIDs.size());
+        int nStripped = 0;
+        for (u32 n = 0; n < anim.nodeIDs.size(); n++) {
+            kept[n] = influencing.count(anim.nodeIDs[n]) != 0;
+            if (!kept[n]) {
+                stripped.insert(anim.nodeIDs[n]);
+                nStripped++;
+            }
+        }
+        if (nStripped == 0) continue;
+
+        if (anim.tracks.empty()) stripSampledNodes(&anim, kept);
+        else stripTrackNodes(&anim, kept);
+        printf("Animation %s: stripped %d nodes that influence nothing\n", anim.id.c_str(), nStripped);
+    }
+
+    if (!stripped.empty()) {
+        printf("Stripped the animation of:");
+        std::vector<std::string> names(stripped.begin(), stripped.end());
+        std::sort(names.begin(), names.end());
+        for (size_t c = 0; c < names.size(); c++) printf("%s %s", c ? "," : "", names[c].c_str());
+        printf("\n  use -N to keep any of them\n");
+    }
+}
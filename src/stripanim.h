@@ -0,0 +1,16 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_STRIPANIM_H
+#define PB_FBX_CONV_STRIPANIM_H
+
+#include "model.h"
+#include "args.h"
+
+// With opts->stripUnusedNodes, removes the animation of nodes that influence nothing: nodes without parts that no
+// bone binding references and that have no such descendant, so moving them can't move a vertex. Nodes named in
+// opts->keepNodes, and their ancestors, always keep their animation. The nodes themselves stay in the node tree.
+void stripUnusedAnimation(Model *model, Options *opts);
+
+#endif //PB_FBX_CONV_STRIPANIM_H
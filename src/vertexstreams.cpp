@@ -0,0 +1,233 @@
+//
+// Created on 10/18/26.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include "vertexstreams.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define STREAMS_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STREAMS_SSE2 1
+#endif
+
+using namespace ofbx;
+
+
+// ---------------------- Scalar ------------------------
+
+// Vec2/3/4 are tightly packed doubles, so a stream of them is just an array of doubles.
+static inline void narrowScalar(const double *in, float *out, int count) {
+    for (int c = 0; c < count; c++) {
+        out[c] = (float) in[c];
+    }
+}
+
+static inline u32 packColor(const Vec4 &color) {
+    u8 r = u8(color.x >= 1.0 ? 255 : color.x * 256.0);
+    u8 g = u8(color.y >= 1.0 ? 255 : color.y * 256.0);
+    u8 b = u8(color.z >= 1.0 ? 255 : color.z * 256.0);
+    u8 a = u8(color.w >= 1.0 ? 255 : color.w * 256.0);
+    return u32(a)<<24 | u32(b)<<16 | u32(g)<<8 | u32(r);
+}
+
+void convertVec2StreamScalar(const Vec2 *in, float *out, int count, bool flipV) {
+    for (int c = 0; c < count; c++) {
+        out[2*c+0] = float(in[c].x);
+        out[2*c+1] = flipV ? float(1.0 - in[c].y) : float(in[c].y);
+    }
+}
+
+void convertVec3StreamScalar(const Vec3 *in, float *out, int count) {
+    narrowScalar(&in->x, out, count * 3);
+}
+
+void convertVec4StreamScalar(const Vec4 *in, float *out, int count) {
+    narrowScalar(&in->x, out, count * 4);
+}
+
+void packColorStreamScalar(const Vec4 *in, u32 *out, int count) {
+    for (int c = 0; c < count; c++) {
+        out[c] = packColor(in[c]);
+    }
+}
+
+
+// ---------------------- SIMD ------------------------
+// cvtpd_ps rounds with the current rounding mode, exactly like a scalar (float) cast,
+// and cvttpd_epi32 truncates exactly like the scalar double -> integer conversion.
+
+#if STREAMS_AVX
+
+static void narrow(const double *in, float *out, int count) {
+    int c = 0;
+    for (; c + 4 <= count; c += 4) {
+        _mm_storeu_ps(out + c, _mm256_cvtpd_ps(_mm256_loadu_pd(in + c)));
+    }
+    narrowScalar(in + c, out + c, count - c);
+}
+
+static void narrowFlipV(const double *in, float *out, int count) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    int c = 0;
+    for (; c + 4 <= count; c += 4) {
+        __m256d uv = _mm256_loadu_pd(in + c);
+        __m256d flipped = _mm256_blend_pd(uv, _mm256_sub_pd(one, uv), 0xA); // flip lanes 1 and 3 (the Vs)
+        _mm_storeu_ps(out + c, _mm256_cvtpd_ps(flipped));
+    }
+    convertVec2StreamScalar((const Vec2 *) (in + c), out + c, (count - c) / 2, true);
+}
+
+static void packColors(const Vec4 *in, u32 *out, int count) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d scale = _mm256_set1_pd(256.0);
+    const __m256d max = _mm256_set1_pd(255.0);
+    const __m128i lowBytes = _mm_set1_epi32(0xFF);
+    for (int c = 0; c < count; c++) {
+        __m256d color = _mm256_loadu_pd(&in[c].x);
+        __m256d saturated = _mm256_cmp_pd(color, one, _CMP_GE_OQ);
+        __m256d scaled = _mm256_blendv_pd(_mm256_mul_pd(color, scale), max, saturated);
+        __m128i ints = _mm_and_si128(_mm256_cvttpd_epi32(scaled), lowBytes);
+        __m128i shorts = _mm_packs_epi32(ints, ints);
+        out[c] = u32(_mm_cvtsi128_si32(_mm_packus_epi16(shorts, shorts)));
+    }
+}
+
+#elif STREAMS_SSE2
+
+static void narrow(const double *in, float *out, int count) {
+    int c = 0;
+    for (; c + 4 <= count; c += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + c));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + c + 2));
+        _mm_storeu_ps(out + c, _mm_movelh_ps(lo, hi));
+    }
+    narrowScalar(in + c, out + c, count - c);
+}
+
+static void narrowFlipV(const double *in, float *out, int count) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d vMask = _mm_castsi128_pd(_mm_set_epi32(-1, -1, 0, 0)); // selects the high lane (V)
+    int c = 0;
+    for (; c + 4 <= count; c += 4) {
+        __m128d uv0 = _mm_loadu_pd(in + c);
+        __m128d uv1 = _mm_loadu_pd(in + c + 2);
+        uv0 = _mm_or_pd(_mm_andnot_pd(vMask, uv0), _mm_and_pd(vMask, _mm_sub_pd(one, uv0)));
+        uv1 = _mm_or_pd(_mm_andnot_pd(vMask, uv1), _mm_and_pd(vMask, _mm_sub_pd(one, uv1)));
+        _mm_storeu_ps(out + c, _mm_movelh_ps(_mm_cvtpd_ps(uv0), _mm_cvtpd_ps(uv1)));
+    }
+    convertVec2StreamScalar((const Vec2 *) (in + c), out + c, (count - c) / 2, true);
+}
+
+static void packColors(const Vec4 *in, u32 *out, int count) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d scale = _mm_set1_pd(256.0);
+    const __m128d max = _mm_set1_pd(255.0);
+    const __m128i lowBytes = _mm_set1_epi32(0xFF);
+    for (int c = 0; c < count; c++) {
+        __m128d rg = _mm_loadu_pd(&in[c].x);
+        __m128d ba = _mm_loadu_pd(&in[c].z);
+        __m128d rgSat = _mm_cmpge_pd(rg, one);
+        __m128d baSat = _mm_cmpge_pd(ba, one);
+        rg = _mm_or_pd(_mm_and_pd(rgSat, max), _mm_andnot_pd(rgSat, _mm_mul_pd(rg, scale)));
+        ba = _mm_or_pd(_mm_and_pd(baSat, max), _mm_andnot_pd(baSat, _mm_mul_pd(ba, scale)));
+        __m128i ints = _mm_unpacklo_epi64(_mm_cvttpd_epi32(rg), _mm_cvttpd_epi32(ba));
+        ints = _mm_and_si128(ints, lowBytes);
+        __m128i shorts = _mm_packs_epi32(ints, ints);
+        out[c] = u32(_mm_cvtsi128_si32(_mm_packus_epi16(shorts, shorts)));
+    }
+}
+
+#else
+
+static void narrow(const double *in, float *out, int count) {
+    narrowScalar(in, out, count);
+}
+
+static void narrowFlipV(const double *in, float *out, int count) {
+    convertVec2StreamScalar((const Vec2 *) in, out, count / 2, true);
+}
+
+static void packColors(const Vec4 *in, u32 *out, int count) {
+    packColorStreamScalar(in, out, count);
+}
+
+#endif
+
+void convertVec2Stream(const Vec2 *in, float *out, int count, bool flipV) {
+    if (flipV) narrowFlipV(&in->x, out, count * 2);
+    else       narrow(&in->x, out, count * 2);
+}
+
+void convertVec3Stream(const Vec3 *in, float *out, int count) {
+    narrow(&in->x, out, count * 3);
+}
+
+void convertVec4Stream(const Vec4 *in, float *out, int count) {
+    narrow(&in->x, out, count * 4);
+}
+
+void packColorStream(const Vec4 *in, u32 *out, int count) {
+    packColors(in, out, count);
+}
+
+const char *vertexStreamInstructionSet() {
+#if STREAMS_AVX
+    return "AVX";
+#elif STREAMS_SSE2
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+
+// ---------------------- Benchmark ------------------------
+
+const int benchmarkIterations = 200;
+
+template<class T, class Scalar, class Simd>
+static void benchmarkStream(const char *name, const T *in, int count, int width, Scalar scalar, Simd simd) {
+    if (!in || count == 0) return;
+    std::vector<float> a(count * width), b(count * width);
+
+    clock_t start = clock();
+    for (int c = 0; c < benchmarkIterations; c++) scalar(in, a.data(), count);
+    clock_t mid = clock();
+    for (int c = 0; c < benchmarkIterations; c++) simd(in, b.data(), count);
+    clock_t end = clock();
+
+    bool identical = memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+    double scalarMs = double(mid - start) * 1000 / CLOCKS_PER_SEC;
+    double simdMs = double(end - mid) * 1000 / CLOCKS_PER_SEC;
+    printf("  %-9s %8d verts  scalar %8.3fms  %s %8.3fms  %s\n", name, count, scalarMs,
+           vertexStreamInstructionSet(), simdMs, identical ? "identical" : "MISMATCH");
+}
+
+void benchmarkVertexStreams(const IScene *scene) {
+    printf("Benchmarking vertex stream conversion (%d iterations per stream)\n", benchmarkIterations);
+    int nMeshes = scene->getMeshCount();
+    for (int c = 0; c < nMeshes; c++) {
+        const Geometry *geom = scene->getMesh(c)->getGeometry();
+        int n = geom->getVertexCount();
+        printf(" Mesh %d:\n", c);
+        benchmarkStream("position", geom->getVertices(), n, 3, convertVec3StreamScalar, convertVec3Stream);
+        benchmarkStream("normal", geom->getNormals(), n, 3, convertVec3StreamScalar, convertVec3Stream);
+        benchmarkStream("tangent", geom->getTangents(), n, 3, convertVec3StreamScalar, convertVec3Stream);
+        benchmarkStream("color", geom->getColors(), n, 4, convertVec4StreamScalar, convertVec4Stream);
+        benchmarkStream("colorpack", geom->getColors(), n, 1,
+                        [](const Vec4 *in, float *out, int count) { packColorStreamScalar(in, (u32 *) out, count); },
+                        [](const Vec4 *in, float *out, int count) { packColorStream(in, (u32 *) out, count); });
+        benchmarkStream("uv", geom->getUVs(), n, 2,
+                        [](const Vec2 *in, float *out, int count) { convertVec2StreamScalar(in, out, count, false); },
+                        [](const Vec2 *in, float *out, int count) { convertVec2Stream(in, out, count, false); });
+        benchmarkStream("uv flipV", geom->getUVs(), n, 2,
+                        [](const Vec2 *in, float *out, int count) { convertVec2StreamScalar(in, out, count, true); },
+                        [](const Vec2 *in, float *out, int count) { convertVec2Stream(in, out, count, true); });
+    }
+}
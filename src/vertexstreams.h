@@ -0,0 +1,30 @@
+//
+// Created on 10/18/26.
+//
+
+#ifndef PB_FBX_CONV_VERTEXSTREAMS_H
+#define PB_FBX_CONV_VERTEXSTREAMS_H
+
+#include "ofbx.h"
+#include "types.h"
+
+// Bulk conversion of whole Geometry attribute streams from doubles to the formats stored in vertices.
+// Each function has a scalar reference version; the unsuffixed version uses SSE2/AVX when they are
+// available at compile time and produces bit-identical results to the scalar version.
+
+void convertVec2Stream(const ofbx::Vec2 *in, float *out, int count, bool flipV);
+void convertVec3Stream(const ofbx::Vec3 *in, float *out, int count);
+void convertVec4Stream(const ofbx::Vec4 *in, float *out, int count);
+void packColorStream(const ofbx::Vec4 *in, u32 *out, int count);
+
+void convertVec2StreamScalar(const ofbx::Vec2 *in, float *out, int count, bool flipV);
+void convertVec3StreamScalar(const ofbx::Vec3 *in, float *out, int count);
+void convertVec4StreamScalar(const ofbx::Vec4 *in, float *out, int count);
+void packColorStreamScalar(const ofbx::Vec4 *in, u32 *out, int count);
+
+const char *vertexStreamInstructionSet();
+
+// Converts every geometry in the scene with both paths, verifies that they match and prints timings.
+void benchmarkVertexStreams(const ofbx::IScene *scene);
+
+#endif //PB_FBX_CONV_VERTEXSTREAMS_H
@@ -43,7 +43,21 @@ static void writeMeshPart(MeshPart *part, BaseJSONWriter &writer) {
     writer.obj(3);
     writer << "id" = part->id;
     writer << "type" = primitiveNames[part->primitive];
-    writer.val("indices").data(part->indices, 12);
+    if (part->lod != 0) {
+        writer << "lod" = part->lod;
+    }
+    if (part->indexWidth != 16) {
+        writer << "indexwidth" = part->indexWidth;
+    }
+    if (part->indexWidth == 32) {
+        writer.val("indices").data(part->indices, 12);
+    } else if (part->indexWidth == 8) {
+        std::vector<u8> indices(part->indices.begin(), part->indices.end());
+        writer.val("indices").data(indices, 12);
+    } else {
+        std::vector<u16> indices(part->indices.begin(), part->indices.end());
+        writer.val("indices").data(indices, 12);
+    }
     writer.end();
 }
 
@@ -53,7 +67,34 @@ static void writeMesh(ModelMesh *mesh, BaseJSONWriter &writer) {
     writer.val("attributes");
     writeAttributes(mesh->attributes, writer);
 
-    writer.val("vertices").data(mesh->vertices, mesh->vertexSize);
+    if (mesh->packedVertexSize != 0) {
+        int nAttrs = countSetBits(mesh->attributes);
+        writer.val("formats").arr(nAttrs, 1000);
+        for (int f = 1, c = 0; f < ATTR_MAX; f <<= 1, c++) {
+            if (f & mesh->attributes) writer.val(formatNames[mesh->formats[c]]);
+        }
+        writer.end();
+        writer.val("offsets").arr(nAttrs, 1000);
+        for (int f = 1, c = 0; f < ATTR_MAX; f <<= 1, c++) {
+            if (f & mesh->attributes) writer.val(mesh->offsets[c]);
+        }
+        writer.end();
+        writer << "vertexsize" = mesh->packedVertexSize;
+        if ((mesh->attributes & ATTR_POSITION) && mesh->formats[0] == FORMAT_UNORM16) {
+            writer << "positionbounds" = mesh->positionBounds;
+        }
+        bool unormTexCoords = false;
+        for (int c = 0; c < MAX_TEX_COORDS; c++) {
+            Attributes f = ATTR_TEXCOORD0 << c;
+            if ((mesh->attributes & f) && mesh->formats[6 + c] == FORMAT_UNORM16) unormTexCoords = true;
+        }
+        if (unormTexCoords) {
+            writer << "texcoordbounds" = mesh->texCoordBounds;
+        }
+        writer.val("vertices").data(mesh->packedVertices, mesh->packedVertexSize);
+    } else {
+        writer.val("vertices").data(mesh->vertices, mesh->vertexSize);
+    }
 
     writer.val("parts").arr(mesh->parts.size());
     for (MeshPart &part : mesh->parts) {
@@ -115,6 +156,9 @@ static void writeNodePart(NodePart *part, BaseJSONWriter &writer) {
     writer.obj();
     writer << "meshpartid" = part->meshPartID;
     writer << "materialid" = part->materialID;
+    if (part->lod != 0) {
+        writer << "lod" = part->lod;
+    }
     if (!part->bones.empty()) {
         writer.val("bones").arr(part->bones.size());
         for (BoneBinding &binding : part->bones) {
@@ -191,11 +235,121 @@ static void writeG3dAnimation(Animation *anim, BaseJSONWriter &writer) {
     writer.end(); // {}
 }
 
+static bool nextKeyTime(const AnimationTrack **tracks, const size_t *next, float *time) {
+    bool found = false;
+    for (int c = 0; c < 3; c++) {
+        if (!tracks[c] || next[c] >= tracks[c]->times.size()) continue;
+        float t = tracks[c]->times[next[c]];
+        if (!found || t < *time) *time = t;
+        found = true;
+    }
+    return found;
+}
+
+// Keyed animations write one keyframe per distinct key time of a bone, with only the channels keyed at that time.
+static void writeG3dTracks(Animation *anim, BaseJSONWriter &writer) {
+    writer.obj(2);
+    writer << "id" = anim->id;
+    u32 nNodes = anim->nodeIDs.size();
+    writer.val("bones").arr(nNodes);
+    for (u32 c = 0; c < nNodes; c++) {
+        const AnimationTrack *tracks[3] = {nullptr, nullptr, nullptr};
+        for (AnimationTrack &track : anim->tracks) {
+            if (track.node == c) tracks[track.channel] = &track;
+        }
+        size_t next[3] = {0, 0, 0};
+        u32 nKeys = 0;
+        float keyTime;
+        while (nextKeyTime(tracks, next, &keyTime)) {
+            for (int d = 0; d < 3; d++) {
+                if (tracks[d] && next[d] < tracks[d]->times.size() && tracks[d]->times[next[d]] == keyTime) next[d]++;
+            }
+            nKeys++;
+        }
+
+        writer.obj(2);
+        writer << "boneId" = anim->nodeIDs[c];
+        writer.val("keyframes").arr(nKeys);
+        next[0] = next[1] = next[2] = 0;
+        while (nextKeyTime(tracks, next, &keyTime)) {
+            writer.obj();
+            writer << "keytime" = (keyTime * 1000);
+            // same order as writeG3dAnimation
+            static const u32 order[3] = {CHANNEL_ROTATION, CHANNEL_TRANSLATION, CHANNEL_SCALE};
+            for (u32 channel : order) {
+                const AnimationTrack *track = tracks[channel];
+                if (!track || next[channel] >= track->times.size() || track->times[next[channel]] != keyTime) continue;
+                int width = channel == CHANNEL_ROTATION ? 4 : 3;
+                writer.val(channelNames[channel]).data(&track->values[next[channel] * width], width);
+                next[channel]++;
+            }
+            writer.end();
+        }
+        writer.end(); // keyframes[]
+        writer.end(); // {}
+    }
+    writer.end(); // bones[]
+    writer.end(); // {}
+}
+
 static void writeP3dAnimation(Animation *anim, BaseJSONWriter &writer) {
-    writer.obj(7);
+    if (!anim->alias.empty()) {
+        writer.obj(2);
+        writer << "id" = anim->id;
+        writer << "alias" = anim->alias;
+        writer.end();
+        return;
+    }
+    if (!anim->tracks.empty()) {
+        // tracks without times key every frame, see dedupAnimations
+        bool sampled = false;
+        for (AnimationTrack &track : anim->tracks) {
+            if (track.refAnimation < 0 && track.times.empty()) sampled = true;
+        }
+        writer.obj(4 + sampled + anim->planar + anim->additive);
+        writer << "id" = anim->id;
+        writer << "duration" = (anim->samplingRate * (anim->frames - 1));
+        if (sampled) writer << "frames" = anim->frames;
+        if (anim->planar) writer << "layout" = "planar";
+        if (anim->additive) writer << "encoding" = "additive";
+        writer << "bones" = anim->nodeIDs;
+        writer.val("tracks").arr(anim->tracks.size());
+        for (AnimationTrack &track : anim->tracks) {
+            if (track.refAnimation >= 0) {
+                writer.obj(3);
+                writer << "bone" = track.node;
+                writer << "channel" = channelNames[track.channel];
+                u32 ref[2] = {u32(track.refAnimation), u32(track.refTrack)};
+                writer << "ref" = ref;
+                writer.end();
+                continue;
+            }
+            writer.obj(track.times.empty() ? 3 : 4);
+            writer << "bone" = track.node;
+            writer << "channel" = channelNames[track.channel];
+            if (!track.times.empty()) writer << "times" = track.times;
+            if (track.compressed) {
+                writer << "bits" = track.bits;
+                if (track.channel != CHANNEL_ROTATION || anim->additive) {
+                    writer << "min" = track.min;
+                    writer << "extent" = track.extent;
+                }
+                writer.val("data").data(track.packed, 16);
+            } else {
+                writer << "values" = track.values;
+            }
+            writer.end();
+        }
+        writer.end();
+        writer.end();
+        return;
+    }
+    writer.obj(7 + anim->planar + anim->additive);
     writer << "id" = anim->id;
     writer << "duration" = (anim->samplingRate * (anim->frames - 1));
     writer << "frames" = anim->frames;
+    if (anim->planar) writer << "layout" = "planar";
+    if (anim->additive) writer << "encoding" = "additive";
     writer << "bones" = anim->nodeIDs;
     writer << "formats" = anim->nodeFormats;
     writer << "stride" = anim->stride;
@@ -229,8 +383,9 @@ static void writeModel(Model *model, BaseJSONWriter &writer, bool pbAnimations)
 
     writer.val("animations").arr(model->animations.size());
     for (Animation &anim : model->animations) {
-        if (pbAnimations) writeP3dAnimation(&anim, writer);
-        else              writeG3dAnimation(&anim, writer);
+        if (pbAnimations)              writeP3dAnimation(&anim, writer);
+        else if (!anim.tracks.empty()) writeG3dTracks(&anim, writer);
+        else                           writeG3dAnimation(&anim, writer);
     }
     writer.end();
 